@@ -1,5 +1,12 @@
 #include "aucont.h"
+#include "cgroups.h"
+#include "events.h"
+#include "exec_stdio.h"
+#include "logs.h"
+#include "registry.h"
 #include "error_codes.h"
+#include "utils.h"
+#include "zygote.h"
 #include <iostream>
 #include <algorithm>
 #include <arpa/inet.h>
@@ -13,178 +20,49 @@
 #include <vector>
 #include <memory>
 #include <fstream>
+#include <sstream>
+#include <functional>
 #include <wait.h>
 #include <syscall.h>
 #include <grp.h>
 #include <sys/mount.h>
-
-
-class aucont_exception: public std::exception
-{
-public:
-    aucont_exception(std::string const &what_str):
-        what_str(what_str)
-    {
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <dirent.h>
+#include <sched.h>
+#include <string.h>
+#include <thread>
+
+
+// Bind mounts host path into image. Read only volume is remounted keeping
+// flags which are locked for us in user ns (nosuid, nodev, ...)
+void mount_volume(std::string const &image_path, volume_spec const &volume) {
+    struct stat host_stat;
+    check_result(stat(volume.host_path.c_str(), &host_stat), "Volume host path '" + volume.host_path + "' not found");
+    std::string const target = image_path + volume.cont_path;
+    if (S_ISDIR(host_stat.st_mode)) {
+        make_dirs(target);
+    } else {
+        make_dirs(target.substr(0, target.rfind('/')));
+        close(check_result(open(target.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666),
+                           "Failed to create volume mount point " + volume.cont_path));
     }
-
-    const char* what() const throw()
-    {
-        return what_str.c_str();
+    check_result(mount(volume.host_path.c_str(), target.c_str(), nullptr, MS_BIND | MS_REC, nullptr),
+                 "Failed to bind mount volume " + volume.host_path);
+    if (volume.read_only) {
+        struct statvfs target_stat;
+        check_result(statvfs(target.c_str(), &target_stat), "Failed to stat volume " + volume.cont_path);
+        unsigned long flags = MS_BIND | MS_REMOUNT | MS_RDONLY;
+        flags |= (target_stat.f_flag & ST_NOSUID) ? MS_NOSUID : 0;
+        flags |= (target_stat.f_flag & ST_NODEV) ? MS_NODEV : 0;
+        flags |= (target_stat.f_flag & ST_NOEXEC) ? MS_NOEXEC : 0;
+        flags |= (target_stat.f_flag & ST_NOATIME) ? MS_NOATIME : 0;
+        flags |= (target_stat.f_flag & ST_NODIRATIME) ? MS_NODIRATIME : 0;
+        flags |= (target_stat.f_flag & ST_RELATIME) ? MS_RELATIME : 0;
+        check_result(mount(nullptr, target.c_str(), nullptr, flags, nullptr),
+                     "Failed to remount volume " + volume.cont_path + " read only");
     }
-
-private:
-    std::string what_str;
-};
-
-// Checks if check_return_code(return_code)
-// Throws aucont_exception if !check_return_code(return_code) with 'exception_message'
-// Returns return_code
-int check_result(int return_code, std::string const &exception_message,
-                 bool (*check_return_code)(int) = [](int code){return code != -1;}) {
-    if (!check_return_code(return_code)) {
-        throw(aucont_exception(exception_message));
-    }
-    return return_code;
-}
-
-void exec_check_result(std::string const &command) {
-    check_result(system(command.c_str()),
-                 "command '" + command + "' execution failed",
-                 [](int code) {return code == 0;});
-}
-
-void mount_cgroup(std::string const &base_dir, std::string const &cgroup) {
-    static int const ALREADY_MOUNTED_ERR = 8192;
-    std::string cgroup_dir = base_dir + '/' + cgroup;
-    std::string exec_str = "sudo mount -t cgroup " + cgroup + " -o " + cgroup + " " + cgroup_dir +
-            "  > /dev/null 2>&1";
-    exec_check_result("mkdir -p " + cgroup_dir);
-    check_result(system(exec_str.c_str()), "Failed to execute mount command:\n\t'" +
-                 exec_str + '\'', [](int err) { return err == 0 || err == ALREADY_MOUNTED_ERR;});
-}
-
-static char const *SEM_NAME = "/aucont_pids_storage_sem";
-static std::string const PIDS_FILE_NAME = "pids_storage";
-
-sem_t* lock(sem_t *sem) {
-    check_result(sem_wait(sem), "Failed to wait named semaphore");
-    return sem;
-}
-
-void unlock(sem_t *sem) {
-    check_result(sem_post(sem), "Failed to wait named semaphore");
-}
-
-class pids_storage {
-private:
-    typedef std::unique_ptr<sem_t, void (*)(sem_t*)> sem_guard;
-public:
-    pids_storage() {
-        sem = sem_open(SEM_NAME, O_CREAT, 0666, 1);
-        if (sem == SEM_FAILED) {
-            throw(aucont_exception("Failed to open named semaphore"));
-        }
-        exec_check_result("touch " + PIDS_FILE_NAME);
-        file.open(PIDS_FILE_NAME);
-        if (!file.is_open()) {
-            sem_close(sem);
-            throw(aucont_exception("Failed to open pids file"));
-        }
-    }
-
-    ~pids_storage() {
-        sem_close(sem);
-    }
-
-    void push_back(int pid) {
-        sem_guard guard(lock(sem), unlock);
-        file.seekp(0L, std::ios_base::end).write(reinterpret_cast<char*>(&pid), sizeof(int)).flush();
-    }
-
-    bool remove_by_idx(size_t id) {
-        sem_guard guard(lock(sem), unlock);
-        return remove_by_idx_unsafe(id, pids_count());
-    }
-
-    // Warn: complexity is O(n)
-    bool remove_by_pid(int pid) {
-        sem_guard guard(lock(sem), unlock);
-        size_t count = pids_count();
-        size_t pos_found = 0;
-        while(pos_found != count) {
-            int cur_pid;
-            file.seekg(pos_found * sizeof(int), std::ios_base::beg).
-                    read(reinterpret_cast<char*>(&cur_pid), sizeof(int));
-            if (cur_pid == pid) {
-                break;
-            }
-            pos_found += 1;
-        }
-        if (pos_found == count) {
-            return false;
-        }
-
-        return remove_by_idx_unsafe(pos_found, count);
-    }
-
-    bool get_pid(size_t idx, int &pid) {
-        sem_guard guard(lock(sem), unlock);
-        if (pids_count() <= idx) {
-            return false;
-        } else {
-            file.seekg(idx * sizeof(int), std::ios_base::beg).read(reinterpret_cast<char*>(&pid), sizeof(int));
-            return true;
-        }
-    }
-
-private:
-    bool remove_by_idx_unsafe(size_t idx, size_t count)
-    {
-        if (idx >= count) {
-            return false;
-        }
-        int pid;
-        file.seekg(sizeof(int), std::ios_base::end).read(reinterpret_cast<char*>(&pid), sizeof(int));
-        file.seekp(idx * sizeof(int), std::ios_base::beg).
-                write(reinterpret_cast<char*>(&pid), sizeof(int)).flush();
-
-        bool tr_succ = truncate(PIDS_FILE_NAME.c_str(), (count - 1) * sizeof(int)) == 0;
-        assert(tr_succ);
-        return true;
-    }
-
-    size_t pids_count() {
-        file.clear();
-        auto file_size_in_bytes = file.seekg(0L, std::ios_base::end).tellg();
-        if (file_size_in_bytes % sizeof(int) != 0) {
-            throw(aucont_exception("Invalid pids file. Size % sizeof(int) != 0. File size = " +
-                                   std::to_string(file_size_in_bytes)));
-        }
-        return static_cast<size_t>(file_size_in_bytes / sizeof(int));
-    }
-
-private:
-    std::fstream file;
-    sem_t *sem;
-};
-
-std::ostream& printDebug() {
-    return std::cout << "Debug: ";
-}
-
-std::string to_string(in_addr_t ip) {
-    char buffer[INET_ADDRSTRLEN + 1];
-    inet_ntop(AF_INET, &ip, buffer, INET_ADDRSTRLEN);
-    return buffer;
-}
-
-bool process_exist(int pid) {
-    // from man kill
-    // If sig is 0, then no signal is sent,
-    // but error checking is still performed;
-    // this can be used to check for the
-    // existence of a process ID or process group ID.
-    return kill(pid, 0) == 0;
 }
 
 void mknod_mount_dev(std::string const &what) {
@@ -193,16 +71,18 @@ void mknod_mount_dev(std::string const &what) {
 }
 
 struct container_main_args {
-    container_main_args(int pipe_descriptors[2], start_arguments const &args, std::string const &net_id):
+    container_main_args(int pipe_descriptors[2], start_arguments const &args, std::string const &net_id, int log_fd):
         first(pipe_descriptors[0], pipe_descriptors[1]),
         second(args),
-        net_id(net_id)
+        net_id(net_id),
+        log_fd(log_fd)
     {
     }
 
     std::pair<int, int> first;
     start_arguments second;
     std::string net_id;
+    int log_fd; // -1 - output isn't logged, otherwise write end of log collector pipe
 };
 
 int container_main(void *container_main_args_ptr) {
@@ -232,9 +112,29 @@ int container_main(void *container_main_args_ptr) {
 
         /*Setup filesystem layout*****************/
         check_result(mount("proc", (args.image_path + "/proc").c_str(), "proc", 0, nullptr), "Failed to mount proc fs");
-        check_result(mount("tmp", (args.image_path + "/tmp").c_str(), "tmpfs", 0, nullptr), "Failed to mount tmp fs");
+        // tmpfs pages are charged to memory cgroup of the process which touches them,
+        // so /tmp usage is accounted and limited with the rest of container memory
+        std::string tmp_options;
+        if (args.tmp_size) {
+            tmp_options = "size=" + std::to_string(args.tmp_size);
+        }
+        if (args.tmp_inodes) {
+            tmp_options += (tmp_options.empty() ? "" : ",") + ("nr_inodes=" + std::to_string(args.tmp_inodes));
+        }
+        check_result(mount("tmp", (args.image_path + "/tmp").c_str(), "tmpfs", 0,
+                           tmp_options.empty() ? nullptr : tmp_options.c_str()), "Failed to mount tmp fs");
         check_result(mount("sys", (args.image_path + "/sys").c_str(), "sysfs", 0, nullptr), "Failed to mount sys fs");
 
+        for (volume_spec const &volume: args.volumes) {
+            mount_volume(args.image_path, volume);
+        }
+        for (tmpfs_spec const &tmpfs: args.tmpfs_mounts) {
+            std::string const target = args.image_path + tmpfs.cont_path;
+            make_dirs(target);
+            check_result(mount("tmpfs", target.c_str(), "tmpfs", MS_NOSUID | MS_NODEV, ("size=" + tmpfs.size).c_str()),
+                         "Failed to mount tmpfs " + tmpfs.cont_path);
+        }
+
         check_result(chdir(args.image_path.c_str()), "Failed to chdir to image_path");
 
 //        check_result(mount("sandbox-dev", "dev", "tmpfs",
@@ -282,10 +182,19 @@ int container_main(void *container_main_args_ptr) {
 
         if (args.daemonize) {
             freopen("/dev/null", "r", stdin);
-            freopen("/dev/null", "w", stdout);
-            freopen("/dev/null", "w", stderr);
+            if (args_holder->log_fd == -1) {
+                freopen("/dev/null", "w", stdout);
+                freopen("/dev/null", "w", stderr);
+            }
             check_result(setsid(), "Failed to create new session and precess group");
         }
+        if (args_holder->log_fd != -1) {
+            fflush(stdout);
+            fflush(stderr);
+            check_result(dup2(args_holder->log_fd, STDOUT_FILENO), "Failed to redirect stdout to log");
+            check_result(dup2(args_holder->log_fd, STDERR_FILENO), "Failed to redirect stderr to log");
+            close(args_holder->log_fd);
+        }
 
 
         if (args.debug_enabled) {
@@ -304,20 +213,492 @@ int container_main(void *container_main_args_ptr) {
     }
 }
 
-static std::string const CGROUP_DIR = "/tmp/aucont/cgroup";
-static std::string const CPU_CGROUP_DIR = CGROUP_DIR + "/cpu";
+// Creates (if needed) and returns dummy interface used as macvlan/ipvlan parent
+// when no physical parent interface is specified
+std::string setup_dummy_parent() {
+    static std::string const DUMMY_PARENT = "aucont-dummy0";
+    exec_check_result("ip link show " + DUMMY_PARENT + " > /dev/null 2>&1 || "
+                      "sudo ip link add " + DUMMY_PARENT + " type dummy");
+    exec_check_result("sudo ip link set " + DUMMY_PARENT + " up");
+    return DUMMY_PARENT;
+}
+
+char const *net_mode_name(net_mode_t mode) {
+    switch (mode) {
+    case NET_MODE_MACVLAN:
+        return "macvlan";
+    case NET_MODE_IPVLAN:
+        return "ipvlan";
+    default:
+        return "veth";
+    }
+}
+
+static size_t const CONTAINER_MAIN_STACK_SIZE = 1 << 12; // 4kb
+static char CONTAINER_MAIN_STACK[CONTAINER_MAIN_STACK_SIZE] = {0};
+static char *CONTAINER_MAIN_STACK_TOP = CONTAINER_MAIN_STACK + CONTAINER_MAIN_STACK_SIZE - 1;
+static int const CLONE_FLAGS =
+            CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWPID | CLONE_NEWNS | SIGCHLD | CLONE_NEWUSER | CLONE_NEWNET;
+static int const JOIN_CLONE_FLAGS = CLONE_NEWUTS | CLONE_NEWPID | CLONE_NEWNS | SIGCHLD | CLONE_PARENT;
+
+// Clones container process which shares user, net and ipc ns with join_pid container.
+// Helper process enters join_pid namespaces (setns to user ns is not allowed for
+// us because we may have other threads/fs sharing) and clones container with
+// CLONE_PARENT so it is our child as usual. Returns container pid.
+int clone_joined_container(int join_pid, container_main_args *cont_main_args) {
+    int pid_pipe[2];
+    check_result(pipe2(pid_pipe, O_CLOEXEC), "Failed to create pid pipe");
+    int const helper_pid = check_result(fork(), "Failed to fork join helper");
+    if (helper_pid == 0) {
+        close(pid_pipe[0]);
+        int pid = -1;
+        try {
+            std::string const join_pid_str = std::to_string(join_pid);
+            set_ns(join_pid_str, "user");
+            set_ns(join_pid_str, "ipc");
+            set_ns(join_pid_str, "net");
+            pid = check_result(clone(container_main, CONTAINER_MAIN_STACK_TOP, JOIN_CLONE_FLAGS, cont_main_args),
+                               "Failed to clone joined child process");
+        } catch(std::exception &e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+        }
+        write(pid_pipe[1], &pid, sizeof(pid));
+        _exit(0);
+    }
+    close(pid_pipe[1]);
+    int pid = -1;
+    ssize_t read_size = read(pid_pipe[0], &pid, sizeof(pid));
+    close(pid_pipe[0]);
+    waitpid(helper_pid, nullptr, 0);
+    check_result(read_size == sizeof(pid) && pid > 0, "Failed to join container " + std::to_string(join_pid),
+                 [](int ok) { return ok != 0; });
+    return pid;
+}
+
+// Limits traffic in both directions of veth pair and marks container packets
+// with TOS so host qdiscs can prioritize them after forwarding (ip_forward
+// derives skb priority from TOS). Everything is installed on host end, out of
+// reach of the container: traffic to container is shaped by its root qdisc,
+// traffic from container is policed on its ingress. Policer is used instead of
+// ifb redirect because it vanishes together with veth pair on container exit.
+void setup_net_shaping(start_arguments const &args, std::string const &net_id) {
+    static std::string const DEFAULT_POLICE_BURST = "64kb";
+    std::string const host_dev = "u-" + net_id + "-0";
+    if (!args.net_rate.empty() || args.net_prio != NET_PRIO_NONE) {
+        exec_check_result("sudo tc qdisc add dev " + host_dev + " clsact");
+    }
+    if (!args.net_rate.empty()) {
+        if (args.net_burst.empty()) { // htb limits whole link, fq maxrate would limit each flow
+            exec_check_result("sudo tc qdisc add dev " + host_dev + " root handle 1: htb default 1");
+            exec_check_result("sudo tc class add dev " + host_dev + " parent 1: classid 1:1 htb rate " +
+                              args.net_rate);
+        } else {
+            exec_check_result("sudo tc qdisc add dev " + host_dev + " root tbf rate " + args.net_rate +
+                              " burst " + args.net_burst + " latency 50ms");
+        }
+        // conforming packets continue to TOS filter
+        exec_check_result("sudo tc filter add dev " + host_dev + " ingress prio 1 protocol all u32 match u32 0 0 "
+                          "action police rate " + args.net_rate + " burst " +
+                          (args.net_burst.empty() ? DEFAULT_POLICE_BURST : args.net_burst) +
+                          " conform-exceed drop/continue");
+    }
+    if (args.net_prio != NET_PRIO_NONE) {
+        char const *tos = args.net_prio == NET_PRIO_INTERACTIVE ? "0x10" :
+                          args.net_prio == NET_PRIO_BULK ? "0x08" : "0x00";
+        exec_check_result("sudo tc filter add dev " + host_dev + " ingress prio 2 protocol ip u32 match u32 0 0 "
+                          "action pedit ex munge ip tos set " + tos + " pipe action csum ip");
+    }
+}
+
+// Page size in hugetlb cgroup files format: 64KB, 2MB, 1GB
+std::string hugepage_size_label(unsigned long long page_size) {
+    if (page_size >= (1ULL << 30)) {
+        return std::to_string(page_size >> 30) + "GB";
+    }
+    if (page_size >= (1ULL << 20)) {
+        return std::to_string(page_size >> 20) + "MB";
+    }
+    return std::to_string(page_size >> 10) + "KB";
+}
+
+// Mounts hugetlbfs in container's mount ns under image_path/dev. hugetlbfs
+// can't be mounted from user ns, so host root does it with nsenter before
+// container starts. The mounts are part of image_path tree bound by
+// container_main and vanish together with container's mount ns.
+void setup_hugepages(start_arguments const &args, std::string const &hugetlb_dir, std::string const &pid_str) {
+    std::string const in_cont_mnt = "sudo nsenter --mount=/proc/" + pid_str + "/ns/mnt ";
+    for (size_t spec_idx = 0; spec_idx < args.hugepages.size(); ++spec_idx) {
+        hugepages_spec const &spec = args.hugepages[spec_idx];
+        std::string const label = hugepage_size_label(spec.page_size);
+        std::string const sysfs_dir = "/sys/kernel/mm/hugepages/hugepages-" +
+                std::to_string(spec.page_size >> 10) + "kB";
+        check_result(access(sysfs_dir.c_str(), F_OK), "Huge page size " + label + " is not supported");
+
+        std::string const limit = std::to_string(spec.page_size * spec.count);
+        write_cgroup_file(hugetlb_dir, "hugetlb." + label + ".limit_in_bytes", limit);
+
+        std::string const mount_point = args.image_path + "/dev/hugepages" + (spec_idx ? "-" + label : "");
+        exec_check_result(in_cont_mnt + "mkdir -p " + mount_point);
+        exec_check_result(in_cont_mnt + "mount -t hugetlbfs -o pagesize=" + std::to_string(spec.page_size) +
+                          ",size=" + limit + ",uid=" + std::to_string(getuid()) +
+                          ",gid=" + std::to_string(getgid()) + ",mode=0755 none " + mount_point);
+    }
+}
+
+static std::string const FROZEN_STATE = "FROZEN";
+static std::string const THAWED_STATE = "THAWED";
+
+// freezer.state of container cgroup is owned by container user (see
+// setup_container_cgroups), so pause/resume don't need sudo and are fast
+// enough to be done on every published port connection. Without wait_settled
+// returns right after the write, state may still be in transition.
+void set_freezer_state(int pid, std::string const &state, bool wait_settled = true) {
+    std::string const freezer_dir = container_cgroup_dir(FREEZER_CGROUP_DIR, pid);
+    {
+        std::ofstream state_file(freezer_dir + "/freezer.state");
+        if (!(state_file << state << std::flush)) {
+            throw aucont_exception("Failed to set freezer state of container " + std::to_string(pid));
+        }
+    }
+    if (!wait_settled) {
+        return;
+    }
+    // FREEZING is reported until all tasks are frozen
+    static int const STATE_POLL_US = 1000;
+    static int const STATE_POLL_TRIES = 5000;
+    for (int tries = 0; tries < STATE_POLL_TRIES; ++tries) {
+        if (read_cgroup_value(freezer_dir, "freezer.state") == state) {
+            return;
+        }
+        usleep(STATE_POLL_US);
+    }
+    throw aucont_exception("Container " + std::to_string(pid) + " didn't reach " + state + " state");
+}
+
+// Freezes container after idle_sec seconds without CPU usage. Frozen
+// container is thawed by aucont resume or by published port connection.
+void run_idle_freezer(int pid, int idle_sec, bool debug_enabled) {
+    std::string const cpuacct_dir = container_cgroup_dir(CPUACCT_CGROUP_DIR, pid);
+    std::string const freezer_dir = container_cgroup_dir(FREEZER_CGROUP_DIR, pid);
+    unsigned long long last_usage = std::stoull(read_cgroup_value(cpuacct_dir, "cpuacct.usage"));
+    int idle_for_sec = 0;
+    while (process_exist(pid)) {
+        sleep(1);
+        if (read_cgroup_value(freezer_dir, "freezer.state") != THAWED_STATE) {
+            idle_for_sec = 0;
+            continue;
+        }
+        unsigned long long const usage = std::stoull(read_cgroup_value(cpuacct_dir, "cpuacct.usage"));
+        idle_for_sec = usage - last_usage < IDLE_USAGE_NS_PER_SEC ? idle_for_sec + 1 : 0;
+        last_usage = usage;
+        if (idle_for_sec >= idle_sec) {
+            set_freezer_state(pid, FROZEN_STATE);
+            idle_for_sec = 0;
+            if (debug_enabled) {
+                printDebug() << "Container " << pid << " is frozen after " << idle_sec << "s of idle" << std::endl;
+            }
+        }
+    }
+}
+
+// Forks helper process running body while container works, body exceptions are
+// reported to stderr. Daemonized container helpers leave our session.
+int fork_helper(std::string const &name, bool daemonize, std::function<void()> const &body) {
+    int const helper_pid = check_result(fork(), "Failed to fork " + name);
+    if (helper_pid == 0) {
+        if (daemonize) {
+            setsid();
+        }
+        int return_code = 0;
+        try {
+            body();
+        } catch(std::exception &e) {
+            std::cerr << name << " exception: " << e.what() << std::endl;
+            return_code = EXCEPTION_OCCURED_ERROR;
+        }
+        _exit(return_code);
+    }
+    return helper_pid;
+}
+
+// Container output pipe is owned by collector process after this, log_pipe_read is reset
+int fork_log_collector(start_arguments const &args, container_record const &record, int &log_pipe_read) {
+    int const pipe_fd = log_pipe_read;
+    std::string const id = record.id;
+    int const collector_pid = fork_helper("Log collector", args.daemonize, [pipe_fd, &id, &args]() {
+        run_log_collector(pipe_fd, id, args.log_size, args.log_files, args.debug_enabled);
+    });
+    close(log_pipe_read);
+    log_pipe_read = -1;
+    return collector_pid;
+}
+
+// Scheduling policy is inherited by all container processes, exec'd commands
+// take it from container init (see aucont_exec)
+void setup_cpu_sched(start_arguments const &args, int pid) {
+    if (args.cpu_sched == CPU_SCHED_NORMAL) {
+        return;
+    }
+    sched_param param = {};
+    int const policy = args.cpu_sched == CPU_SCHED_BATCH ? SCHED_BATCH : SCHED_IDLE;
+    check_result(sched_setscheduler(pid, policy, &param), "Failed to set container scheduling policy");
+}
+
+// Creates container cgroups, applies limits and moves pid into them
+void setup_container_cgroups(start_arguments const &args, int pid) {
+    std::string const pid_str(std::to_string(pid));
+
+    mount_cgroup(CGROUP_DIR, "cpu");
+    mount_cgroup(CGROUP_DIR, "memory");
+    mount_cgroup(CGROUP_DIR, "blkio");
+    mount_cgroup(CGROUP_DIR, "cpuacct");
+    mount_cgroup(CGROUP_DIR, "cpuset");
+    if (!args.slice.empty() && access((CPU_CGROUP_DIR + "/" + args.slice).c_str(), F_OK) != 0) {
+        throw aucont_exception("Slice " + args.slice + " doesn't exist, create it with aucont slice create");
+    }
+
+
+    /*Create cpu cgroup***************************/
+    std::string const current_cpu_dir = cgroup_dir_of(CPU_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_cpu_dir);
+
+
+    /*Setup CPU limit*************************/
+    long const cpu_period = args.cpu_period_us ? args.cpu_period_us : DEFAULT_CPU_PERIOD_US;
+    long const cpu_quota = cpu_quota_us(args.cpu_limit, cpu_period);
+    if (args.debug_enabled) {
+        printDebug() << "Cpus count is " << sysconf(_SC_NPROCESSORS_ONLN) << std::endl;
+        printDebug() << "Cpus quota is " << cpu_quota << '/' << cpu_period << std::endl;
+        if (args.cpu_burst_us) {
+            printDebug() << "Cpus burst is " << args.cpu_burst_us << std::endl;
+        }
+    }
+    exec_check_result("echo " + std::to_string(cpu_period) +  " | sudo tee " + current_cpu_dir + "/cpu.cfs_period_us > /dev/null");
+    exec_check_result("echo " + std::to_string(cpu_quota) +  " | sudo tee " + current_cpu_dir + "/cpu.cfs_quota_us > /dev/null");
+    if (args.cpu_burst_us) { // cpu.cfs_burst_us appeared in linux 5.14
+        write_cgroup_file(current_cpu_dir, "cpu.cfs_burst_us", std::to_string(args.cpu_burst_us));
+    }
+    if (args.cpu_shares) {
+        write_cgroup_file(current_cpu_dir, "cpu.shares", std::to_string(args.cpu_shares));
+    }
+    exec_check_result("echo " + pid_str +  " | sudo tee " + current_cpu_dir + "/tasks > /dev/null");
+
+
+    /*Setup memory limit**********************/
+    std::string const current_memory_dir = cgroup_dir_of(MEMORY_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_memory_dir);
+    if (args.memory_limit) {
+        write_cgroup_file(current_memory_dir, "memory.limit_in_bytes", std::to_string(args.memory_limit));
+    }
+    write_cgroup_file(current_memory_dir, "tasks", pid_str);
+
+
+    /*Create blkio cgroup (limits are set by aucont update)*/
+    std::string const current_blkio_dir = cgroup_dir_of(BLKIO_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_blkio_dir);
+    write_cgroup_file(current_blkio_dir, "tasks", pid_str);
+
+
+    /*Create cpuacct and freezer cgroups******/
+    std::string const current_cpuacct_dir = cgroup_dir_of(CPUACCT_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_cpuacct_dir);
+    write_cgroup_file(current_cpuacct_dir, "tasks", pid_str);
+    mount_cgroup(CGROUP_DIR, "freezer");
+    std::string const current_freezer_dir = cgroup_dir_of(FREEZER_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_freezer_dir);
+    exec_check_result("sudo chown " + std::to_string(getuid()) + ":" + std::to_string(getgid()) + " " +
+                      current_freezer_dir + "/freezer.state");
+    write_cgroup_file(current_freezer_dir, "tasks", pid_str);
+
+
+    /*Create perf_event cgroup (counted by aucont perf)*/
+    mount_cgroup(CGROUP_DIR, "perf_event");
+    std::string const current_perf_event_dir = cgroup_dir_of(PERF_EVENT_CGROUP_DIR, args.slice, pid_str);
+    exec_check_result("sudo mkdir -m 755 -p " + current_perf_event_dir);
+    write_cgroup_file(current_perf_event_dir, "tasks", pid_str);
+
+
+    /*Setup huge pages************************/
+    if (!args.hugepages.empty()) {
+        mount_cgroup(CGROUP_DIR, "hugetlb");
+        std::string const current_hugetlb_dir = cgroup_dir_of(HUGETLB_CGROUP_DIR, args.slice, pid_str);
+        exec_check_result("sudo mkdir -m 755 -p " + current_hugetlb_dir);
+        setup_hugepages(args, current_hugetlb_dir, pid_str);
+        write_cgroup_file(current_hugetlb_dir, "tasks", pid_str);
+    }
+}
+
+// 12 hex digits from /dev/urandom
+std::string new_container_id() {
+    std::ifstream urandom("/dev/urandom", std::ios::binary);
+    unsigned char bytes[6];
+    if (!urandom.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        throw aucont_exception("Failed to read /dev/urandom");
+    }
+    char id[sizeof(bytes) * 2 + 1];
+    for (size_t byte_idx = 0; byte_idx < sizeof(bytes); ++byte_idx) {
+        snprintf(id + byte_idx * 2, 3, "%02x", bytes[byte_idx]);
+    }
+    return id;
+}
+
+container_record make_record(start_arguments const &args, int pid) {
+    container_record record = {};
+    set_record_field(record.id, new_container_id());
+    set_record_field(record.name, args.name);
+    record.pid = pid;
+    record.proc_start_time = process_start_time(pid);
+    record.start_time = time(nullptr);
+    record.cpu_limit = args.cpu_limit;
+    record.memory_limit = args.memory_limit;
+    record.cont_ip = args.net_enabled ? args.cont_ip : 0;
+    set_record_field(record.image, args.template_name.empty() ? args.image_path : "template:" + args.template_name);
+    std::string cmd = args.cmd;
+    for (size_t cmd_arg_idx = 0; cmd_arg_idx < args.cmd_args_count; ++cmd_arg_idx) {
+        cmd += std::string(" ") + args.cmd_args[cmd_arg_idx + 1];
+    }
+    set_record_field(record.cmd, cmd);
+    set_record_field(record.cgroup, cgroup_dir_of("", args.slice, std::to_string(pid)));
+    return record;
+}
+
+// JSON fields of record besides id, name and pid
+std::string record_details_json(container_record const &record) {
+    std::ostringstream details;
+    details << "\"image\":\"" << json_escape(record.image) << "\",\"cmd\":\"" << json_escape(record.cmd)
+            << "\",\"start_time\":" << record.start_time << ",\"cpu_limit\":" << record.cpu_limit
+            << ",\"memory_limit\":" << record.memory_limit
+            << ",\"ip\":" << (record.cont_ip ? "\"" + to_string(record.cont_ip) + "\"" : std::string("null"))
+            << ",\"cgroup\":\"" << json_escape(record.cgroup) << '"';
+    return details.str();
+}
+
+// Registry record of container, only pid is set if it isn't registered
+container_record registered_record(int pid) {
+    container_record record = {};
+    record.pid = pid;
+    container_registry().find_by_pid(pid, record);
+    return record;
+}
+
+// Fails early instead of after container is set up
+void check_name_unused(std::string const &name) {
+    container_record record;
+    if (!name.empty() && container_registry().find_by_name(name, record)) {
+        throw aucont_exception("Container name " + name + " is already used by " + std::to_string(record.pid));
+    }
+}
+
+// Forks container from template zygote instead of cloning it from scratch
+int start_from_template(start_arguments const &args, int *started_pid) {
+    int conn = -1;
+    int log_pipe[2] = {-1, -1};
+    try {
+        if (args.debug_enabled) {
+            printDebug() << "Starting from template " << args.template_name << std::endl;
+            printDebug() << "cmd is '" << args.cmd << '\'' << std::endl;
+        }
+        check_name_unused(args.name);
+        if (args.log_enabled) {
+            check_result(pipe2(log_pipe, O_CLOEXEC), "Failed to create log pipe");
+        }
+        int const pid = zygote_fork_container(args.template_name, args.cmd, args.cmd_args, args.daemonize,
+                                              log_pipe[1], conn);
+        if (log_pipe[1] != -1) {
+            close(log_pipe[1]);
+            log_pipe[1] = -1;
+        }
+        setup_container_cgroups(args, pid);
+        setup_cpu_sched(args, pid);
+
+        container_registry registry;
+        container_record const record = make_record(args, pid);
+        registry.add(record);
+        publish_event("start", record, record_details_json(record));
+        zygote_release_container(conn);
+
+        std::cout << pid << std::endl;
+        if (started_pid) {
+            *started_pid = pid;
+        }
+
+        int const collector_pid = args.log_enabled ? fork_log_collector(args, record, log_pipe[0]) : 0;
+        int freezer_pid = 0;
+        if (args.freeze_idle_sec) {
+            freezer_pid = fork_helper("Idle freezer", args.daemonize, [pid, &args]() {
+                run_idle_freezer(pid, args.freeze_idle_sec, args.debug_enabled);
+            });
+        }
+
+        int return_code = 0;
+        if (!args.daemonize) {
+            return_code = zygote_wait_container(conn);
+            publish_event("exit", record, exit_status_fields(return_code));
+            if (freezer_pid) { // exits by itself after container
+                waitpid(freezer_pid, nullptr, 0);
+            }
+            if (collector_pid) { // exits after the rest of container output
+                waitpid(collector_pid, nullptr, 0);
+            }
+            bool removed = registry.remove_by_pid(pid);
+            if (args.debug_enabled) {
+                printDebug() << "Container finished. Exit code: " << return_code << std::endl;
+                printDebug() << "Pid " << (removed ? "is removed" : "has been already removed") << std::endl;
+            }
+        }
+        close(conn);
+        return return_code;
+    } catch(std::exception &e) {
+        if (conn != -1) { // forked container exits without 'g'
+            close(conn);
+        }
+        for (int fd: log_pipe) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+int aucont_start(start_arguments const &args, int *started_pid) {
+    if (!args.template_name.empty()) {
+        return start_from_template(args, started_pid);
+    }
 
-int aucont_start(start_arguments const &args) {
     int pipe_descriptors[2] = {0};
+    int log_pipe[2] = {-1, -1};
     try {
         assert(system(nullptr)); // shel is available
         if (args.debug_enabled) {
             printDebug() << "Cpu limit is " << args.cpu_limit << std::endl;
+            printDebug() << "Memory limit is " << (args.memory_limit ? std::to_string(args.memory_limit) : "none")
+                         << std::endl;
             printDebug() << "Container " << (args.daemonize ? "will" : "won't") << " be daemonized" << std::endl;
+            if (args.log_enabled) {
+                printDebug() << "Output is logged to " << args.log_files << " files of " << args.log_size
+                             << " bytes" << std::endl;
+            }
             printDebug() << "Network is " << (args.net_enabled ? "enabled" : "disabled") << std::endl;
+            if (args.join_pid) {
+                printDebug() << "Joining network and ipc of container " << args.join_pid << std::endl;
+            }
             if (args.net_enabled) {
                 printDebug() << "\tContainer IP is " << to_string(args.cont_ip) << std::endl;
-                printDebug() << "\tHost IP is " << to_string(args.host_ip) << std::endl;
+                printDebug() << "\tNetwork mode is " << net_mode_name(args.net_mode) << std::endl;
+                if (args.net_mode == NET_MODE_VETH) {
+                    printDebug() << "\tHost IP is " << to_string(args.host_ip) << std::endl;
+                } else {
+                    printDebug() << "\tParent interface is '" << args.net_parent << '\'' << std::endl;
+                }
+                printDebug() << "\tQueues: " << args.net_queues << ", MTU: "
+                             << (args.mtu ? std::to_string(args.mtu) : "default") << ", offloads: '"
+                             << args.offloads << '\'' << std::endl;
+                if (!args.net_rate.empty()) {
+                    printDebug() << "\tRate is " << args.net_rate << ", burst is "
+                                 << (args.net_burst.empty() ? "none (htb)" : args.net_burst) << std::endl;
+                }
             }
             printDebug() << "image_path is '" << args.image_path << '\'' << std::endl;
             printDebug() << "cmd is '" << args.cmd << '\'' << std::endl;
@@ -327,69 +708,97 @@ int aucont_start(start_arguments const &args) {
                     printDebug() << '\t' << cmd_arg_idx << ": '" << args.cmd_args[cmd_arg_idx + 1] << '\'' << std::endl;
                 }
             }
+            for (volume_spec const &volume: args.volumes) {
+                printDebug() << "volume '" << volume.host_path << "' -> '" << volume.cont_path << '\''
+                             << (volume.read_only ? " (read only)" : "") << std::endl;
+            }
+            for (tmpfs_spec const &tmpfs: args.tmpfs_mounts) {
+                printDebug() << "tmpfs '" << tmpfs.cont_path << "' size " << tmpfs.size << std::endl;
+            }
+            for (hugepages_spec const &spec: args.hugepages) {
+                printDebug() << "huge pages " << hugepage_size_label(spec.page_size) << " x " << spec.count << std::endl;
+            }
         }
 
+        check_name_unused(args.name);
         std::string net_id = "Net" + std::to_string(getpid());
-        static size_t const CONTAINER_MAIN_STACK_SIZE = 1 << 12; // 4kb
-        static char CONTAINER_MAIN_STACK[CONTAINER_MAIN_STACK_SIZE] = {0};
-        static char *CONTAINER_MAIN_STACK_TOP = CONTAINER_MAIN_STACK + CONTAINER_MAIN_STACK_SIZE - 1;
-        static int const CLONE_FLAGS =
-                    CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWPID | CLONE_NEWNS | SIGCHLD | CLONE_NEWUSER | CLONE_NEWNET;
         check_result(pipe(pipe_descriptors), "Faled to create pipe");
+        if (args.log_enabled) {
+            check_result(pipe2(log_pipe, O_CLOEXEC), "Failed to create log pipe");
+        }
         std::unique_ptr<container_main_args> cont_main_args(new container_main_args(
-                pipe_descriptors, args, net_id));
-        int const pid = check_result(clone(container_main, CONTAINER_MAIN_STACK_TOP, CLONE_FLAGS, cont_main_args.get()),
-                               "Failed to clone child process");
+                pipe_descriptors, args, net_id, log_pipe[1]));
+        int const pid = args.join_pid ?
+                    clone_joined_container(args.join_pid, cont_main_args.get()) :
+                    check_result(clone(container_main, CONTAINER_MAIN_STACK_TOP, CLONE_FLAGS, cont_main_args.get()),
+                                 "Failed to clone child process");
         check_result(close(pipe_descriptors[0]), "Failed to close read pipe");
+        if (log_pipe[1] != -1) { // collector sees EOF when container output is closed
+            close(log_pipe[1]);
+            log_pipe[1] = -1;
+        }
 
 
         /*Map uid, gid********************************/
         std::string const pid_str(std::to_string(pid));
-        exec_check_result("echo deny > /proc/" + pid_str + "/setgroups");
-        std::string const uid_str = std::to_string(getuid());
-        std::string const gid_str = std::to_string(getgid());
-        exec_check_result("echo 0 " + uid_str + " 1 >> /proc/" + pid_str + "/uid_map");
-        exec_check_result("echo 0 " + gid_str + " 1 >> /proc/" + pid_str + "/gid_map");
+        if (!args.join_pid) { // joined container lives in already mapped user ns
+            exec_check_result("echo deny > /proc/" + pid_str + "/setgroups");
+            std::string const uid_str = std::to_string(getuid());
+            std::string const gid_str = std::to_string(getgid());
+            exec_check_result("echo 0 " + uid_str + " 1 >> /proc/" + pid_str + "/uid_map");
+            exec_check_result("echo 0 " + gid_str + " 1 >> /proc/" + pid_str + "/gid_map");
+        }
 
 
         /*Create cgroups******************************/
-        mount_cgroup(CGROUP_DIR, "cpu");
-        mount_cgroup(CGROUP_DIR, "memory");
-        mount_cgroup(CGROUP_DIR, "blkio");
-        mount_cgroup(CGROUP_DIR, "cpuacct");
-        mount_cgroup(CGROUP_DIR, "cpuset");
-
-
-        /*Create cpu cgroup***************************/
-        std::string const current_cpu_dir = CPU_CGROUP_DIR + "/" + std::to_string(pid);
-        exec_check_result("sudo mkdir -m 755 -p " + current_cpu_dir);
-
-
-        /*Setup CPU limit*************************/
-        static long const CPU_PERIOD_US = 1000 * 1000; // 1sec
-        static long const CPU_QUOTA_PER_PERCENT = CPU_PERIOD_US / 100;
-        long cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
-        long cpu_quota = CPU_QUOTA_PER_PERCENT * args.cpu_limit * cpus_count;
-        if (args.debug_enabled) {
-            printDebug() << "Cpus count is " << cpus_count << std::endl;
-            printDebug() << "Cpus quota is " << cpu_quota << '/' << CPU_PERIOD_US << std::endl;
-        }
-        exec_check_result("echo " + std::to_string(CPU_PERIOD_US) +  " | sudo tee " + current_cpu_dir + "/cpu.cfs_period_us > /dev/null");
-        exec_check_result("echo " + std::to_string(cpu_quota) +  " | sudo tee " + current_cpu_dir + "/cpu.cfs_quota_us > /dev/null");
-        exec_check_result("echo " + pid_str +  " | sudo tee " + current_cpu_dir + "/tasks > /dev/null");
+        setup_container_cgroups(args, pid);
+        setup_cpu_sched(args, pid);
 
 
         /*Setup networking************************/
         if (args.net_enabled) {
-            exec_check_result("sudo ip link add name u-" + net_id + "-0 type veth peer name u-" + net_id + "-1");
+            // Queues, MTU and offloads are set at creation, before the interface is moved to container
+            std::string link_params = " numtxqueues " + std::to_string(args.net_queues) +
+                    " numrxqueues " + std::to_string(args.net_queues);
+            if (args.mtu) {
+                link_params += " mtu " + std::to_string(args.mtu);
+            }
+            if (args.net_mode == NET_MODE_VETH) {
+                exec_check_result("sudo ip link add name u-" + net_id + "-0" + link_params +
+                                  " type veth peer name u-" + net_id + "-1" + link_params);
+                if (!args.offloads.empty()) {
+                    exec_check_result("sudo ethtool -K u-" + net_id + "-0 " + args.offloads + " > /dev/null");
+                }
+            } else {
+                // No host side interface: container talks directly through parent
+                std::string parent = args.net_parent.empty() ? setup_dummy_parent() : args.net_parent;
+                std::string type = args.net_mode == NET_MODE_MACVLAN ? "macvlan mode bridge" : "ipvlan mode l2";
+                exec_check_result("sudo ip link add link " + parent + " name u-" + net_id + "-1" + link_params +
+                                  " type " + type);
+            }
+            if (!args.offloads.empty()) {
+                exec_check_result("sudo ethtool -K u-" + net_id + "-1 " + args.offloads + " > /dev/null");
+            }
             exec_check_result("sudo ip link set u-" + net_id + "-1 netns " + pid_str);
-            exec_check_result("sudo ip link set u-" + net_id + "-0 up");
-            exec_check_result("sudo ip addr add " + to_string(args.host_ip) + "/24 dev u-" + net_id + "-0");
+            if (args.net_mode == NET_MODE_VETH) {
+                exec_check_result("sudo ip link set u-" + net_id + "-0 up");
+                exec_check_result("sudo ip addr add " + to_string(args.host_ip) + "/24 dev u-" + net_id + "-0");
+                setup_net_shaping(args, net_id);
+            }
+        }
+
+
+        /*Bind published ports********************/
+        std::unique_ptr<port_forwarder> forwarder;
+        if (!args.publish.empty()) {
+            forwarder.reset(new port_forwarder(args.cont_ip, args.publish, args.debug_enabled));
         }
 
 
-        pids_storage pids;
-        pids.push_back(pid);
+        container_registry registry;
+        container_record const record = make_record(args, pid);
+        registry.add(record);
+        publish_event("start", record, record_details_json(record));
 
 
         check_result(write(pipe_descriptors[1], "g", 1), "Failed to write to pipe");
@@ -397,6 +806,41 @@ int aucont_start(start_arguments const &args) {
 
 
         std::cout << pid << std::endl;
+        if (started_pid) {
+            *started_pid = pid;
+        }
+
+        std::vector<int> helper_pids;
+        if (forwarder) {
+            if (args.freeze_idle_sec) { // connection to frozen container wakes it up
+                // Runs in forwarder event loop: doesn't wait for thaw, connection
+                // is completed by container once it runs, and failure to thaw
+                // mustn't stop forwarding of other connections
+                forwarder->set_connection_hook([pid]() {
+                    try {
+                        if (read_cgroup_value(container_cgroup_dir(FREEZER_CGROUP_DIR, pid), "freezer.state") !=
+                                THAWED_STATE) {
+                            set_freezer_state(pid, THAWED_STATE, false);
+                        }
+                    } catch(std::exception &e) {
+                        std::cerr << "Failed to thaw container " << pid << ": " << e.what() << std::endl;
+                    }
+                });
+            }
+            port_forwarder &forwarder_ref = *forwarder;
+            helper_pids.push_back(fork_helper("Port forwarder", args.daemonize, [pid, &forwarder_ref]() {
+                forwarder_ref.run(pid);
+            }));
+            forwarder.reset(); // listening sockets are owned by forwarder process now
+        }
+        if (args.freeze_idle_sec) {
+            helper_pids.push_back(fork_helper("Idle freezer", args.daemonize, [pid, &args]() {
+                run_idle_freezer(pid, args.freeze_idle_sec, args.debug_enabled);
+            }));
+        }
+        if (args.log_enabled) { // last, so it doesn't hold listening sockets of forwarder
+            helper_pids.push_back(fork_log_collector(args, record, log_pipe[0]));
+        }
 
         if (args.debug_enabled) {
             printDebug() << "Container is" << (process_exist(pid) ? "" : "n't") << " working at the moment ..." << std::endl;
@@ -405,7 +849,11 @@ int aucont_start(start_arguments const &args) {
         if (!args.daemonize) {
             int cont_main_return_code;
             waitpid(pid, &cont_main_return_code, 0);
-            bool removed = pids.remove_by_pid(pid);
+            publish_event("exit", record, exit_status_fields(cont_main_return_code));
+            for (int helper_pid: helper_pids) { // exit by themselves after container
+                waitpid(helper_pid, nullptr, 0);
+            }
+            bool removed = registry.remove_by_pid(pid);
             if (args.debug_enabled) {
                 printDebug() << "Container finished. Exit code: " << cont_main_return_code << std::endl;
                 printDebug() << "Pid " << (removed ? "is removed" : "has been already removed") << std::endl;
@@ -419,6 +867,11 @@ int aucont_start(start_arguments const &args) {
             write(pipe_descriptors[1], "s", 1);
             close(pipe_descriptors[1]);
         }
+        for (int fd: log_pipe) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
         std::cerr << "Exception: " << e.what() << std::endl;
         return EXCEPTION_OCCURED_ERROR;
     }
@@ -431,12 +884,23 @@ int aucont_stop(const stop_arguments &args) {
             printDebug() << "PID is " << args.pid << std::endl;
             printDebug() << "SIGNAL is " << args.signal << std::endl;
         }
-        pids_storage pids;
+        container_registry registry;
+        container_record const record = registered_record(args.pid);
 
-        bool removed = pids.remove_by_pid(args.pid);
+        bool removed = registry.remove_by_pid(args.pid);
         bool p_exist = process_exist(args.pid);
         if (removed && p_exist) {
             bool signal_sent = kill(args.pid, args.signal) == 0;
+            if (signal_sent) {
+                publish_event("stop", record, "\"signal\":" + std::to_string(args.signal));
+            }
+            try { // frozen container can't handle signal
+                set_freezer_state(args.pid, THAWED_STATE);
+            } catch(aucont_exception &e) {
+                if (args.debug_enabled) {
+                    printDebug() << e.what() << std::endl;
+                }
+            }
             std::cout << "Signal " << args.signal << (signal_sent ? " was " : " wasn't ")
                       << "sent to process with pid " << args.pid << std::endl;
         } else {
@@ -457,20 +921,64 @@ int aucont_stop(const stop_arguments &args) {
     }
 }
 
-int aucont_list() {
-    try {
-        pids_storage pids;
+// Registered pid may be reused by another process after container exit
+static size_t const LIVENESS_CHECKS_PER_THREAD = 64;
 
-        //std::cout << "Running containers pids:" << std::endl;
+bool container_running(container_record const &record) {
+    return process_alive(record.pid, record.proc_start_time);
+}
 
-        int pid;
-        for (size_t pid_idx = 0; pids.get_pid(pid_idx, pid); ++pid_idx) {
-            if (process_exist(pid)) {
-                //std::cout << pid_idx << ": " << pid << std::endl;
-                std::cout << pid << std::endl;
-            } else {
-//                pids.remove_by_idx(pid_idx); // Not safe! No locking between get_pid and remove_by_idx
-//                pid_idx -= 1;
+// Checks records of registry snapshot on several threads: every check reads
+// /proc, which dominates list time with many containers
+std::vector<char> check_containers_running(std::vector<container_record> const &records) {
+    std::vector<char> running(records.size());
+    size_t const threads_count = std::max<size_t>(1, std::min<size_t>(
+            std::thread::hardware_concurrency(),
+            (records.size() + LIVENESS_CHECKS_PER_THREAD - 1) / LIVENESS_CHECKS_PER_THREAD));
+    auto check_every_nth = [&records, &running, threads_count](size_t first) {
+        for (size_t record_idx = first; record_idx < records.size(); record_idx += threads_count) {
+            running[record_idx] = container_running(records[record_idx]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t thread_idx = 1; thread_idx < threads_count; ++thread_idx) {
+        threads.emplace_back(check_every_nth, thread_idx);
+    }
+    check_every_nth(0);
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    return running;
+}
+
+void print_record_json(container_record const &record) {
+    std::cout << "{\"id\":\"" << json_escape(record.id) << "\",\"name\":\"" << json_escape(record.name)
+              << "\",\"pid\":" << record.pid << ',' << record_details_json(record) << '}';
+}
+
+int aucont_list(list_arguments const &args) {
+    try {
+        container_registry registry;
+        std::vector<container_record> const snapshot = registry.records();
+        std::vector<char> const is_running = check_containers_running(snapshot);
+        std::vector<container_record> running, dead;
+        for (size_t record_idx = 0; record_idx < snapshot.size(); ++record_idx) {
+            (is_running[record_idx] ? running : dead).push_back(snapshot[record_idx]);
+        }
+        // Containers killed without aucont_stop, records added or removed
+        // after the snapshot are left untouched
+        registry.remove_records(dead);
+
+        if (args.format == LIST_FORMAT_JSON) {
+            std::cout << '[';
+            for (size_t record_idx = 0; record_idx < running.size(); ++record_idx) {
+                std::cout << (record_idx ? ",\n " : "");
+                print_record_json(running[record_idx]);
+            }
+            std::cout << ']' << std::endl;
+        } else {
+            for (container_record const &record: running) {
+                std::cout << record.pid << std::endl;
             }
         }
 
@@ -481,18 +989,211 @@ int aucont_list() {
     }
 }
 
-void set_ns(std::string const &pid_str, std::string const &ns_name) {
-    std::string ns_dir_path_str = "/proc/" + pid_str + "/ns/" + ns_name;
-    int ns_dir = check_result(open(ns_dir_path_str.c_str(), O_RDONLY, O_CLOEXEC), "Failed to open ns dir");
-    check_result(setns(ns_dir, 0), "Failed to set ns");
-    check_result(close(ns_dir), "Failed to close ns dir descriptor");
+bool aucont_find_container(std::string const &ref, int &pid) {
+    container_registry registry;
+    container_record record;
+    if (registry.find_by_id(ref, record) || registry.find_by_name(ref, record)) {
+        pid = record.pid;
+        return true;
+    }
+    return false;
+}
+
+// Shell style exit code of waitpid status
+int command_exit_code(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+struct batch_command {
+    std::string line;
+    std::vector<std::string> argv;
+    int pid;
+    int output_fd; // memfd with stdout and stderr of command
+    int status;
+    bool done;
+};
+
+// Splits batch line into words on whitespace. Quotes group words: '...' is
+// taken literally, "..." and unquoted text may escape characters with '\'.
+std::vector<std::string> split_batch_line(std::string const &line) {
+    std::vector<std::string> words;
+    std::string word;
+    bool in_word = false;
+    char quote = 0;
+    for (size_t char_idx = 0; char_idx < line.size(); ++char_idx) {
+        char const c = line[char_idx];
+        bool const escaped = c == '\\' && quote != '\'' && char_idx + 1 < line.size();
+        if (quote && c == quote) {
+            quote = 0;
+        } else if (escaped) {
+            word += line[++char_idx];
+            in_word = true;
+        } else if (quote) {
+            word += c;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            in_word = true;
+        } else if (isspace(static_cast<unsigned char>(c))) {
+            if (in_word) {
+                words.push_back(word);
+                word.clear();
+                in_word = false;
+            }
+        } else {
+            word += c;
+            in_word = true;
+        }
+    }
+    if (quote) {
+        throw aucont_exception("Unterminated quote in batch command: " + line);
+    }
+    if (in_word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// One command per line, empty lines and lines starting with '#' are skipped
+std::vector<batch_command> read_batch(std::string const &file_name) {
+    std::ifstream file;
+    if (file_name != "-") {
+        file.open(file_name);
+        if (!file) {
+            throw aucont_exception("Failed to open batch file " + file_name);
+        }
+    }
+    std::istream &input = file_name == "-" ? std::cin : file;
+    std::vector<batch_command> batch;
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t const first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        batch_command command = {line.substr(first), split_batch_line(line), -1, -1, 0, false};
+        batch.push_back(command);
+    }
+    return batch;
+}
+
+void print_batch_result(batch_command &command, size_t index) {
+    std::cout << "--- [" << index + 1 << "] " << command.line << ": ";
+    if (WIFSIGNALED(command.status)) {
+        std::cout << "killed by signal " << WTERMSIG(command.status) << std::endl;
+    } else {
+        std::cout << "exit " << WEXITSTATUS(command.status) << std::endl;
+    }
+    lseek(command.output_fd, 0, SEEK_SET);
+    copy_fd(command.output_fd, STDOUT_FILENO);
+    close(command.output_fd);
+    command.output_fd = -1;
+}
+
+// Called in forked command process, policy is container init's one
+static void set_command_sched(int policy) {
+    if (policy != SCHED_OTHER) {
+        sched_param param = {};
+        sched_setscheduler(0, policy, &param);
+    }
+}
+
+// Runs batch in already entered container, up to jobs commands at once.
+// Output of a command is kept in memfd while it runs, the pages are charged
+// to container memory cgroup. It is printed with exit status as soon as the
+// command finishes, so only outputs of running commands are kept.
+int run_batch(std::vector<batch_command> &batch, int jobs, int null_fd, int sched_policy, bool debug_enabled) {
+    size_t next_to_start = 0;
+    size_t finished = 0;
+    int running = 0;
+    try {
+        while (finished < batch.size()) {
+            for (; running < jobs && next_to_start < batch.size(); ++next_to_start, ++running) {
+                batch_command &command = batch[next_to_start];
+                command.output_fd = check_result(memfd_create("aucont-batch", MFD_CLOEXEC),
+                                                 "Failed to create output memfd");
+                command.pid = check_result(fork(), "Failed to fork command process");
+                if (command.pid == 0) {
+                    dup2(null_fd, STDIN_FILENO);
+                    dup2(command.output_fd, STDOUT_FILENO);
+                    dup2(command.output_fd, STDERR_FILENO);
+                    setgroups(0, nullptr);
+                    setgid(0);
+                    setuid(0);
+                    set_command_sched(sched_policy);
+
+                    std::vector<char*> argv;
+                    for (std::string &word: command.argv) {
+                        argv.push_back(const_cast<char*>(word.c_str()));
+                    }
+                    argv.push_back(nullptr);
+                    execv(argv[0], argv.data());
+                    std::cerr << "Failed to execute " << command.argv[0] << ": " << strerror(errno) << std::endl;
+                    _exit(EXECUTE_COMMAND_ERROR);
+                }
+                if (debug_enabled) {
+                    printDebug() << "Started [" << next_to_start + 1 << "] as " << command.pid << std::endl;
+                }
+            }
+
+            int status = 0;
+            int const pid = waitpid(-1, &status, 0);
+            if (pid == -1 && errno == EINTR) {
+                continue;
+            }
+            check_result(pid, "Failed to wait batch command");
+            for (size_t command_idx = 0; command_idx < batch.size(); ++command_idx) {
+                batch_command &command = batch[command_idx];
+                if (command.pid == pid && !command.done) {
+                    command.status = status;
+                    command.done = true;
+                    --running;
+                    ++finished;
+                    print_batch_result(command, command_idx);
+                }
+            }
+        }
+    } catch(...) { // started commands don't outlive us
+        for (batch_command &command: batch) {
+            if (command.pid > 0 && !command.done) {
+                kill(command.pid, SIGKILL);
+                while (waitpid(command.pid, nullptr, 0) == -1 && errno == EINTR) {
+                }
+            }
+            if (command.output_fd != -1) {
+                close(command.output_fd);
+            }
+        }
+        throw;
+    }
+
+    size_t failed = 0;
+    int return_code = 0;
+    for (batch_command const &command: batch) {
+        int const exit_code = command_exit_code(command.status);
+        failed += exit_code != 0;
+        if (return_code == 0) {
+            return_code = exit_code;
+        }
+    }
+    std::cout << "--- " << batch.size() << " commands, " << failed << " failed" << std::endl;
+    return return_code;
 }
 
 int aucont_exec(exec_arguments const &args) {
+    int null_fd = -1;
     try {
+        std::vector<batch_command> batch;
+        if (!args.batch_file.empty()) { // host path, read before chroot
+            batch = read_batch(args.batch_file);
+            null_fd = check_result(open("/dev/null", O_RDONLY | O_CLOEXEC), "Failed to open /dev/null");
+        }
         if (args.debug_enabled) {
             printDebug() << "PID is " << args.pid << std::endl;
-            printDebug() << "cmd is '" << args.cmd << '\'' << std::endl;
+            if (!args.batch_file.empty()) {
+                printDebug() << batch.size() << " batch commands, " << args.jobs << " at once" << std::endl;
+            } else {
+                printDebug() << "cmd is '" << args.cmd << '\'' << std::endl;
+            }
             if (args.cmd_args_count) {
                 printDebug() << "cmd_args:" << std::endl;
                 for (size_t cmd_arg_idx = 0; cmd_arg_idx < args.cmd_args_count; ++cmd_arg_idx) {
@@ -501,12 +1202,17 @@ int aucont_exec(exec_arguments const &args) {
             }
         }
         std::string pid_str = std::to_string(args.pid);
+        exec_stdio stdio(args.tty, args.interactive, args.debug_enabled); // host pty, before ns are entered
+        int const sched_policy = check_result(sched_getscheduler(args.pid),
+                                              "Failed to get container scheduling policy");
 
 
-        /*Enter to container's CPU cgroup*************/
-        std::string tasks_path = CPU_CGROUP_DIR + "/" + pid_str + "/tasks";
+        /*Enter to container's cgroups***************/
         std::string cur_pid_str = std::to_string(getpid());
-        exec_check_result("echo " + cur_pid_str + " | sudo tee " + tasks_path + " > /dev/null");
+        for (std::string const &controller_dir: {CPU_CGROUP_DIR, MEMORY_CGROUP_DIR, BLKIO_CGROUP_DIR,
+                                                 CPUACCT_CGROUP_DIR, FREEZER_CGROUP_DIR, PERF_EVENT_CGROUP_DIR}) {
+            write_cgroup_file(container_cgroup_dir(controller_dir, args.pid), "tasks", cur_pid_str);
+        }
 
 
         /*Change work dir ************************/
@@ -528,24 +1234,362 @@ int aucont_exec(exec_arguments const &args) {
         check_result(chroot("."), "Failed to change root");
 
 
-        /*Exec and wait command*******************/
-        int exec_pid = fork();
+        /*Exec and wait commands******************/
+        if (!args.batch_file.empty()) {
+            int const return_code = run_batch(batch, args.jobs, null_fd, sched_policy, args.debug_enabled);
+            close(null_fd);
+            return return_code;
+        }
+        int exec_pid = check_result(fork(), "Failed to fork command process");
         if (exec_pid == 0) {
+            try {
+                stdio.setup_command();
+            } catch(std::exception &e) {
+                std::cerr << "Exception: " << e.what() << std::endl;
+                _exit(EXCEPTION_OCCURED_ERROR);
+            }
             setgroups(0, nullptr);
             setgid(0);
             setuid(0);
+            set_command_sched(sched_policy);
+
+            execv(args.cmd.c_str(), args.cmd_args);
+            _exit(EXECUTE_COMMAND_ERROR);
+        }
+        stdio.relay();
+        int status = 0;
+        while (waitpid(exec_pid, &status, 0) == -1 && errno == EINTR) {
+        }
+        if (args.debug_enabled) {
+            printDebug() << "Command finished, status " << status << std::endl;
+        }
+
+
+        return command_exit_code(status);
+    } catch(std::exception &e) {
+        if (null_fd != -1) {
+            close(null_fd);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+// Returns MAJ:MIN of block device given by path or MAJ:MIN
+std::string block_device_id(std::string const &device) {
+    struct stat device_stat;
+    if (stat(device.c_str(), &device_stat) == 0) {
+        if (!S_ISBLK(device_stat.st_mode)) {
+            throw aucont_exception(device + " is not a block device");
+        }
+        return std::to_string(major(device_stat.st_rdev)) + ":" + std::to_string(minor(device_stat.st_rdev));
+    }
+    unsigned int major_id, minor_id;
+    char tail;
+    if (sscanf(device.c_str(), "%u:%u%c", &major_id, &minor_id, &tail) != 2) {
+        throw aucont_exception("Block device " + device + " not found");
+    }
+    return device;
+}
+
+// Current throttle limit of device in blkio.throttle.* file, "0" if not set
+std::string read_io_limit(std::string const &blkio_dir, std::string const &file, std::string const &device_id) {
+    std::ifstream limits_file(blkio_dir + "/" + file);
+    if (!limits_file) {
+        throw aucont_exception("Failed to read " + blkio_dir + "/" + file);
+    }
+    std::string limit_device, limit;
+    while (limits_file >> limit_device >> limit) {
+        if (limit_device == device_id) {
+            return limit;
+        }
+    }
+    return "0";
+}
+
+// New values of changed limits
+std::string update_event_fields(update_arguments const &args) {
+    static char const *IO_LIMIT_NAMES[] = {"read_bps", "write_bps", "read_iops", "write_iops"};
+    std::ostringstream fields;
+    char const *separator = "";
+    auto field = [&fields, &separator](std::string const &name, long long value) {
+        fields << separator << '"' << name << "\":" << value;
+        separator = ",";
+    };
+    if (args.cpu_limit != -1) {
+        field("cpu_limit", args.cpu_limit);
+    }
+    if (args.cpu_period_us) {
+        field("cpu_period_us", args.cpu_period_us);
+    }
+    if (args.cpu_shares) {
+        field("cpu_shares", args.cpu_shares);
+    }
+    if (args.cpu_burst_us != -1) {
+        field("cpu_burst_us", args.cpu_burst_us);
+    }
+    if (args.memory_limit) {
+        field("memory_limit", args.memory_limit);
+    }
+    if (args.io_weight) {
+        field("io_weight", args.io_weight);
+    }
+    for (io_limit_spec const &limit: args.io_limits) {
+        field(std::string("io_") + IO_LIMIT_NAMES[limit.type] + ":" + json_escape(limit.device), limit.value);
+    }
+    return fields.str();
+}
+
+int aucont_update(update_arguments const &args) {
+    static char const *IO_LIMIT_FILES[] = {
+        "blkio.throttle.read_bps_device", "blkio.throttle.write_bps_device",
+        "blkio.throttle.read_iops_device", "blkio.throttle.write_iops_device"
+    };
+    try {
+        std::string const pid_str = std::to_string(args.pid);
+        if (args.debug_enabled) {
+            printDebug() << "PID is " << args.pid << std::endl;
+        }
+        if (!process_exist(args.pid)) {
+            throw aucont_exception("Process with pid " + pid_str + " is not running atm");
+        }
 
-            if (execv(args.cmd.c_str(), args.cmd_args) == -1) {
-                return EXECUTE_COMMAND_ERROR;
+        // Collect all writes with current values first: nothing is changed if
+        // container or some of its cgroup files are missing
+        std::vector<cgroup_write> writes;
+        if (args.cpu_limit != -1 || args.cpu_period_us || args.cpu_shares || args.cpu_burst_us != -1) {
+            std::string const dir = container_cgroup_dir(CPU_CGROUP_DIR, args.pid);
+            std::string const old_period = read_cgroup_value(dir, "cpu.cfs_period_us");
+            std::string const old_quota = read_cgroup_value(dir, "cpu.cfs_quota_us");
+            long const period = args.cpu_period_us ? args.cpu_period_us : std::stol(old_period);
+            long long quota = std::stoll(old_quota);
+            if (args.cpu_limit != -1) {
+                quota = cpu_quota_us(args.cpu_limit, period);
+            } else if (args.cpu_period_us && old_quota != "-1") { // keep cpu percent
+                quota = quota * period / std::stol(old_period);
             }
-        } else {
-            waitpid(exec_pid, NULL, 0);
+            // Quota to period ratio can't exceed the slice's one even between the
+            // writes, so of new quota with old period and old quota with new
+            // period the lower ratio is written first
+            bool const quota_first = old_quota != "-1" &&
+                    quota * period <= std::stoll(old_quota) * std::stol(old_period);
+            cgroup_write const quota_write = {dir, "cpu.cfs_quota_us", std::to_string(quota), old_quota};
+            if (quota_first && std::to_string(quota) != old_quota) {
+                writes.push_back(quota_write);
+            }
+            if (args.cpu_period_us) {
+                writes.push_back({dir, "cpu.cfs_period_us", std::to_string(period), old_period});
+            }
+            if (!quota_first && std::to_string(quota) != old_quota) {
+                writes.push_back(quota_write);
+            }
+            if (args.cpu_burst_us != -1) {
+                writes.push_back({dir, "cpu.cfs_burst_us", std::to_string(args.cpu_burst_us),
+                                  read_cgroup_value(dir, "cpu.cfs_burst_us")});
+            }
+            if (args.cpu_shares) {
+                writes.push_back({dir, "cpu.shares", std::to_string(args.cpu_shares),
+                                  read_cgroup_value(dir, "cpu.shares")});
+            }
+        }
+        if (args.memory_limit) {
+            std::string const dir = container_cgroup_dir(MEMORY_CGROUP_DIR, args.pid);
+            writes.push_back({dir, "memory.limit_in_bytes", std::to_string(args.memory_limit),
+                              read_cgroup_value(dir, "memory.limit_in_bytes")});
+        }
+        std::string const blkio_dir = args.io_weight || !args.io_limits.empty() ?
+                    container_cgroup_dir(BLKIO_CGROUP_DIR, args.pid) : "";
+        if (args.io_weight) {
+            writes.push_back({blkio_dir, "blkio.weight", std::to_string(args.io_weight),
+                              read_cgroup_value(blkio_dir, "blkio.weight")});
+        }
+        for (io_limit_spec const &limit: args.io_limits) {
+            std::string const device_id = block_device_id(limit.device);
+            std::string const file = IO_LIMIT_FILES[limit.type];
+            // throttle files take "MAJ:MIN VALUE" and are written with echo
+            writes.push_back({blkio_dir, file, "\"" + device_id + " " + std::to_string(limit.value) + "\"",
+                              "\"" + device_id + " " + read_io_limit(blkio_dir, file, device_id) + "\""});
         }
 
+        apply_cgroup_writes(writes, args.debug_enabled);
+        container_record record = registered_record(args.pid);
+        if (record.id[0] && (args.cpu_limit != -1 || args.memory_limit)) { // list shows current limits
+            container_registry().update_limits(record, args.cpu_limit, args.memory_limit);
+        }
+        publish_event("update", record, update_event_fields(args));
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
 
+// hugetlb and perf_event slice dirs are created with first container of slice
+// which uses them
+static std::vector<std::string> const SLICE_CONTROLLERS = {"cpu", "memory", "blkio", "cpuacct", "freezer"};
+static std::vector<std::string> const SLICE_LAZY_CONTROLLERS = {"hugetlb", "perf_event"};
+
+std::vector<cgroup_write> slice_limit_writes(slice_arguments const &args) {
+    std::vector<cgroup_write> writes;
+    std::string const cpu_dir = CPU_CGROUP_DIR + "/" + args.name;
+    std::string const memory_dir = MEMORY_CGROUP_DIR + "/" + args.name;
+    if (args.cpu_limit != -1) {
+        writes.push_back({cpu_dir, "cpu.cfs_period_us", std::to_string(DEFAULT_CPU_PERIOD_US),
+                          read_cgroup_value(cpu_dir, "cpu.cfs_period_us")});
+        writes.push_back({cpu_dir, "cpu.cfs_quota_us", std::to_string(cpu_quota_us(args.cpu_limit,
+                                                                                   DEFAULT_CPU_PERIOD_US)),
+                          read_cgroup_value(cpu_dir, "cpu.cfs_quota_us")});
+    }
+    if (args.cpu_shares) {
+        writes.push_back({cpu_dir, "cpu.shares", std::to_string(args.cpu_shares),
+                          read_cgroup_value(cpu_dir, "cpu.shares")});
+    }
+    if (args.memory_limit) {
+        writes.push_back({memory_dir, "memory.limit_in_bytes", std::to_string(args.memory_limit),
+                          read_cgroup_value(memory_dir, "memory.limit_in_bytes")});
+    }
+    return writes;
+}
+
+bool slice_exists(std::string const &name) {
+    return access((CPU_CGROUP_DIR + "/" + name).c_str(), F_OK) == 0;
+}
+
+// Child cgroup dirs of slice in controller hierarchy (containers, alive or not)
+std::vector<std::string> slice_children(std::string const &slice_dir) {
+    std::vector<std::string> children;
+    std::unique_ptr<DIR, int(*)(DIR*)> dir(opendir(slice_dir.c_str()), closedir);
+    if (!dir) {
+        return children;
+    }
+    while (dirent *entry = readdir(dir.get())) {
+        if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+            children.push_back(slice_dir + "/" + entry->d_name);
+        }
+    }
+    return children;
+}
+
+int aucont_slice_create(slice_arguments const &args) {
+    try {
+        for (std::string const &controller: SLICE_CONTROLLERS) {
+            mount_cgroup(CGROUP_DIR, controller);
+        }
+        if (slice_exists(args.name)) {
+            throw aucont_exception("Slice " + args.name + " already exists");
+        }
+        for (std::string const &controller: SLICE_CONTROLLERS) {
+            exec_check_result("sudo mkdir -m 755 -p " + CGROUP_DIR + "/" + controller + "/" + args.name);
+        }
+        // older kernels account memory of child cgroups only with use_hierarchy
+        write_cgroup_file(MEMORY_CGROUP_DIR + "/" + args.name, "memory.use_hierarchy", "1");
+        apply_cgroup_writes(slice_limit_writes(args), args.debug_enabled);
         return 0;
     } catch(std::exception &e) {
         std::cerr << "Exception: " << e.what() << std::endl;
         return EXCEPTION_OCCURED_ERROR;
     }
 }
+
+int aucont_slice_update(slice_arguments const &args) {
+    try {
+        if (!slice_exists(args.name)) {
+            throw aucont_exception("Slice " + args.name + " doesn't exist");
+        }
+        apply_cgroup_writes(slice_limit_writes(args), args.debug_enabled);
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+int aucont_slice_remove(slice_arguments const &args) {
+    try {
+        if (!slice_exists(args.name)) {
+            throw aucont_exception("Slice " + args.name + " doesn't exist");
+        }
+        std::vector<std::string> controllers = SLICE_CONTROLLERS;
+        controllers.insert(controllers.end(), SLICE_LAZY_CONTROLLERS.begin(), SLICE_LAZY_CONTROLLERS.end());
+        for (std::string const &controller: controllers) {
+            for (std::string const &child: slice_children(CGROUP_DIR + "/" + controller + "/" + args.name)) {
+                if (cgroup_has_tasks(child)) {
+                    throw aucont_exception("Slice " + args.name + " has running containers");
+                }
+            }
+        }
+        // cgroups of exited containers are left behind, they go first
+        for (std::string const &controller: controllers) {
+            std::string const slice_dir = CGROUP_DIR + "/" + controller + "/" + args.name;
+            if (access(slice_dir.c_str(), F_OK) != 0) {
+                continue;
+            }
+            for (std::string const &child: slice_children(slice_dir)) {
+                exec_check_result("sudo rmdir " + child);
+            }
+            exec_check_result("sudo rmdir " + slice_dir);
+            if (args.debug_enabled) {
+                printDebug() << "Removed " << slice_dir << std::endl;
+            }
+        }
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+int aucont_slice_list() {
+    try {
+        std::vector<std::string> slice_dirs = slice_children(CPU_CGROUP_DIR);
+        std::sort(slice_dirs.begin(), slice_dirs.end());
+        for (std::string const &slice_dir: slice_dirs) {
+            std::string const name = slice_dir.substr(slice_dir.rfind('/') + 1);
+            if (std::all_of(name.begin(), name.end(), ::isdigit)) {
+                continue; // top level container
+            }
+            long const quota = std::stol(read_cgroup_value(slice_dir, "cpu.cfs_quota_us"));
+            long const period = std::stol(read_cgroup_value(slice_dir, "cpu.cfs_period_us"));
+            std::vector<std::string> const children = slice_children(slice_dir);
+            std::cout << name
+                      << "\tcpu=" << (quota == -1 ? std::string("none") :
+                                      std::to_string(quota * 100 / period / sysconf(_SC_NPROCESSORS_ONLN)) + "%")
+                      << "\tshares=" << read_cgroup_value(slice_dir, "cpu.shares")
+                      << "\tmem=" << read_cgroup_value(MEMORY_CGROUP_DIR + "/" + name, "memory.limit_in_bytes")
+                      << "\tmem_usage=" << read_cgroup_value(MEMORY_CGROUP_DIR + "/" + name, "memory.usage_in_bytes")
+                      << "\tcontainers=" << std::count_if(children.begin(), children.end(), cgroup_has_tasks)
+                      << std::endl;
+        }
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+int set_container_freezer_state(pause_arguments const &args, std::string const &state) {
+    try {
+        if (args.debug_enabled) {
+            printDebug() << "PID is " << args.pid << std::endl;
+            printDebug() << "Setting freezer state " << state << std::endl;
+        }
+        if (!process_exist(args.pid)) {
+            std::cout << "Process with pid " << args.pid << " is not running atm" << std::endl;
+            return 0;
+        }
+        set_freezer_state(args.pid, state);
+        publish_event(state == FROZEN_STATE ? "pause" : "resume", registered_record(args.pid));
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+int aucont_pause(pause_arguments const &args) {
+    return set_container_freezer_state(args, FROZEN_STATE);
+}
+
+int aucont_resume(pause_arguments const &args) {
+    return set_container_freezer_state(args, THAWED_STATE);
+}
@@ -1,7 +1,57 @@
 #ifndef AUCONT_H
 #define AUCONT_H
+#include "port_forward.h"
 #include <netinet/in.h>
 #include <string>
+#include <vector>
+
+enum net_prio_t {
+    NET_PRIO_NONE,
+    NET_PRIO_INTERACTIVE,
+    NET_PRIO_BESTEFFORT,
+    NET_PRIO_BULK
+};
+
+enum net_mode_t {
+    NET_MODE_VETH,
+    NET_MODE_MACVLAN,
+    NET_MODE_IPVLAN
+};
+
+enum cpu_sched_t {
+    CPU_SCHED_NORMAL,
+    CPU_SCHED_BATCH, // SCHED_BATCH: no wakeup preemption, longer slices
+    CPU_SCHED_IDLE // SCHED_IDLE: runs only when cpu is otherwise idle
+};
+
+struct volume_spec {
+    std::string host_path;
+    std::string cont_path;
+    bool read_only;
+};
+
+struct tmpfs_spec {
+    std::string cont_path;
+    std::string size; // tmpfs size= option
+};
+
+struct hugepages_spec {
+    unsigned long long page_size; // bytes
+    unsigned long long count;
+};
+
+enum io_limit_t {
+    IO_LIMIT_READ_BPS,
+    IO_LIMIT_WRITE_BPS,
+    IO_LIMIT_READ_IOPS,
+    IO_LIMIT_WRITE_IOPS
+};
+
+struct io_limit_spec {
+    io_limit_t type;
+    std::string device; // block device path or MAJ:MIN
+    unsigned long long value; // 0 - remove limit
+};
 
 struct start_arguments {
     std::string image_path;
@@ -9,14 +59,42 @@ struct start_arguments {
     char *const *cmd_args;
     size_t cmd_args_count;
     int cpu_limit;
+    long cpu_period_us = 0; // CFS period, 0 - default (100ms)
+    long cpu_shares = 0; // 0 - default (1024)
+    long cpu_burst_us = 0; // quota which may be accumulated from idle periods, 0 - none
+    cpu_sched_t cpu_sched = CPU_SCHED_NORMAL;
+    unsigned long long memory_limit = 0; // bytes, 0 - unlimited
+    unsigned long long tmp_size = 0; // bytes, 0 - tmpfs default
+    unsigned long long tmp_inodes = 0; // 0 - tmpfs default
     in_addr_t cont_ip;
     in_addr_t host_ip;
     bool net_enabled;
+    net_mode_t net_mode;
+    std::string net_parent; // empty - dummy interface
+    int join_pid; // 0 - don't join, otherwise share user, net and ipc ns with this container
+    std::vector<publish_spec> publish;
+    int net_queues = 1; // tx and rx queues of container interface
+    int mtu = 0; // 0 - kernel default
+    std::string offloads; // ethtool -K arguments, empty - kernel default
+    std::string net_rate; // tc rate, empty - unlimited
+    std::string net_burst; // tc size, empty - htb instead of token bucket
+    net_prio_t net_prio = NET_PRIO_NONE;
+    std::vector<volume_spec> volumes;
+    std::vector<tmpfs_spec> tmpfs_mounts;
+    std::vector<hugepages_spec> hugepages;
+    std::string template_name; // empty - start from image_path, otherwise fork from template zygote
+    int freeze_idle_sec = 0; // 0 - never freeze idle container
+    std::string slice; // empty - top level cgroups
+    std::string name; // empty - unnamed, otherwise unique among registered containers
+    bool log_enabled = false; // false - output goes to our stdio or /dev/null if daemonized
+    unsigned long long log_size = 10 << 20; // bytes per log file
+    int log_files = 3; // current file and rotated ones
     bool daemonize;
     bool debug_enabled;
 };
 
-int aucont_start(start_arguments const &args);
+// If started_pid is not null container pid is stored there
+int aucont_start(start_arguments const &args, int *started_pid = nullptr);
 
 struct stop_arguments {
     int pid;
@@ -25,17 +103,194 @@ struct stop_arguments {
 };
 
 int aucont_stop(stop_arguments const &args);
-int aucont_list();
+
+enum list_format_t {
+    LIST_FORMAT_PIDS,
+    LIST_FORMAT_JSON // all registry record fields
+};
+
+struct list_arguments {
+    list_format_t format = LIST_FORMAT_PIDS;
+};
+
+int aucont_list(list_arguments const &args);
+
+// Finds pid of registered container by id or name
+bool aucont_find_container(std::string const &ref, int &pid);
 
 struct exec_arguments {
     int pid;
     std::string cmd;
     char *const *cmd_args;
     size_t cmd_args_count;
+    bool tty = false; // run command in pseudo terminal
+    bool interactive = false; // forward our stdin to command
+    std::string batch_file; // empty - run cmd, otherwise file of commands to run ("-" - stdin)
+    int jobs = 1; // batch commands run at once
     bool debug_enabled;
 };
 
+// Returns command exit code, 128 + signal number if it was killed. Batch
+// returns exit code of its first failed command, 0 if all succeeded.
 int aucont_exec(exec_arguments const &args);
 
+struct pause_arguments {
+    int pid;
+    bool debug_enabled;
+};
+
+// Freezes/thaws all container processes with freezer cgroup
+int aucont_pause(pause_arguments const &args);
+int aucont_resume(pause_arguments const &args);
+
+struct update_arguments {
+    int pid;
+    int cpu_limit = -1; // percent, -1 - unchanged
+    long cpu_period_us = 0; // 0 - unchanged, quota is scaled to keep cpu percent
+    long cpu_shares = 0; // 0 - unchanged
+    long cpu_burst_us = -1; // -1 - unchanged
+    unsigned long long memory_limit = 0; // 0 - unchanged
+    int io_weight = 0; // 0 - unchanged
+    std::vector<io_limit_spec> io_limits;
+    bool debug_enabled;
+};
+
+// Rewrites cgroup limits of running container. All new values are validated
+// before the first write and already written values are rolled back on failure.
+int aucont_update(update_arguments const &args);
+
+struct slice_arguments {
+    std::string name;
+    int cpu_limit = -1; // percent of all cpus shared by slice containers, -1 - unchanged/unlimited
+    unsigned long long memory_limit = 0; // 0 - unchanged/unlimited
+    int cpu_shares = 0; // cpu time share between slices, 0 - unchanged/default
+    bool debug_enabled;
+};
+
+// Slices group containers under parent cgroups with aggregate limits
+int aucont_slice_create(slice_arguments const &args);
+int aucont_slice_update(slice_arguments const &args);
+// Fails if slice has running containers
+int aucont_slice_remove(slice_arguments const &args);
+int aucont_slice_list();
+
+struct template_arguments {
+    std::string name;
+    std::string image_path;
+    std::vector<std::string> preload; // libraries dlopen'ed by zygote
+    std::string entry; // preloaded function called instead of exec of CMD, empty - exec
+    bool stop;
+    bool debug_enabled;
+};
+
+int aucont_template(template_arguments const &args);
+
+struct bench_net_arguments {
+    std::string image_path;
+    std::string cmd;
+    char *const *cmd_args;
+    size_t cmd_args_count;
+    in_addr_t cont_ip;
+    in_addr_t host_ip;
+    bool udp;
+    int duration_sec;
+    size_t msg_size;
+    size_t latency_samples;
+    int net_queues;
+    int mtu; // 0 - keep default
+    std::string offloads; // ethtool -K arguments, empty - keep default
+    bool baseline; // also measure host loopback
+    bool debug_enabled;
+};
+
+int aucont_bench_net(bench_net_arguments const &args);
+
+struct bench_cpu_arguments {
+    std::string image_path;
+    std::string cmd;
+    char *const *cmd_args;
+    size_t cmd_args_count;
+    std::vector<int> cpu_limits; // one container per limit
+    int workers; // spinners per container
+    int duration_sec;
+    int sample_ms;
+    long cpu_period_us; // 0 - default
+    bool debug_enabled;
+};
+
+// Starts daemonized containers, loads them with spinners and compares
+// achieved cpu with fair share of requested limits
+int aucont_bench_cpu(bench_cpu_arguments const &args);
+
+struct bench_registry_arguments {
+    int clients; // concurrent client processes
+    int ops; // operations per client
+    int list_percent; // share of list operations, the rest is split between push and remove
+    int kills; // clients killed with SIGKILL while running
+    int watchdog_sec; // no progress for this long means deadlock
+    std::string file_name; // private registry file
+    bool debug_enabled;
+};
+
+// Stresses container registry with concurrent clients, reports throughput, lock
+// wait and registry consistency
+int aucont_bench_registry(bench_registry_arguments const &args);
+
+struct events_arguments {
+    int throttle_interval_ms; // cpu.stat polling interval
+    bool debug_enabled;
+};
+
+struct perf_arguments {
+    int pid;
+    int interval_ms;
+    int count; // intervals to report, 0 - until container exits
+    bool debug_enabled;
+};
+
+// Counts cycles, instructions, cache misses and context switches of container
+// perf_event cgroup on every cpu, prints cpu usage, throttling, IPC and miss
+// rates for every interval
+int aucont_perf(perf_arguments const &args);
+
+struct daemon_arguments {
+    int interval_ms = 1000;
+    std::string slice; // controlled containers, empty - all
+    int step_percent = 20; // largest limit change per interval
+    int cpu_target = 10; // cpu pressure percent kept below
+    int cpu_min = 1; // cpu limit bounds, percent
+    int cpu_max = 100;
+    int memory_target = 10;
+    unsigned long long memory_min = 16 << 20; // memory limit bounds
+    unsigned long long memory_max = 0; // 0 - memory limit isn't controlled
+    bool control_limits = true; // false - only reclaim
+    int reclaim_idle_sec = 0; // 0 - idle containers memory isn't reclaimed
+    int reclaim_percent = 10; // of idle container memory usage per interval
+    bool debug_enabled;
+};
+
+// Runs until interrupted: every interval grows or shrinks cpu quota and
+// memory limit of containers within bounds to keep their pressure below target.
+// Memory of containers idle for reclaim_idle_sec is reclaimed down to memory_min
+// and their soft limit is dropped so global reclaim takes it first. Stops on
+// SIGINT or SIGTERM restoring soft limits.
+int aucont_daemon(daemon_arguments const &args);
+
+struct logs_arguments {
+    std::string id; // container id, name or pid
+    bool follow; // wait for new output until container exits
+    bool debug_enabled;
+};
+
+// Prints output captured from container started with --log, oldest first.
+// Logs are kept after container exit, only logs of the last MAX_EXITED_LOGS
+// exited containers (see logs.h).
+int aucont_logs(logs_arguments const &args);
+
+// Prints container events as JSON lines until interrupted: start, stop,
+// update, pause and resume published by commands, exit (with status if
+// container was started without daemonization), oom and throttle
+int aucont_events(events_arguments const &args);
+
 
 #endif // AUCONT_H
@@ -0,0 +1,272 @@
+#include "aucont.h"
+#include "cgroups.h"
+#include "error_codes.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <wait.h>
+
+
+static double const CALIBRATION_SEC = 0.2;
+static uint64_t const SPIN_BATCH = 1 << 16; // loops between progress updates
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Spin loop whose speed is calibrated, so progress of spinners is a second
+// measure of cpu time next to cpuacct
+static uint64_t spin(uint64_t loops) {
+    volatile uint64_t value = 0;
+    for (uint64_t loop = 0; loop < loops; ++loop) {
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return value;
+}
+
+static double thread_cpu_seconds() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Spin loops per second of cpu time
+static double calibrate_spin() {
+    double const started = thread_cpu_seconds();
+    uint64_t loops = 0;
+    while (thread_cpu_seconds() - started < CALIBRATION_SEC) {
+        spin(SPIN_BATCH);
+        loops += SPIN_BATCH;
+    }
+    return loops / (thread_cpu_seconds() - started);
+}
+
+struct cgroup_sample {
+    uint64_t usage_ns; // cpuacct.usage
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+    uint64_t throttled_ns;
+    uint64_t spin_loops;
+};
+
+struct bench_container {
+    int pid;
+    int cpu_limit;
+    double expected_cpus; // fair share under contention
+    std::string cpu_dir;
+    std::string cpuacct_dir;
+    std::vector<int> spinner_pids;
+    volatile uint64_t *progress; // spin loops of each spinner, shared with them
+    cgroup_sample last;
+    std::vector<double> cpus; // achieved cpus in each interval
+    std::vector<double> error_pct;
+    std::vector<double> work_error_pct; // same measured by spin progress
+    std::vector<double> stall_ms; // average throttle stall in intervals with throttling
+    uint64_t periods;
+    uint64_t throttled;
+};
+
+static cgroup_sample sample_cgroup(bench_container const &cont, int workers) {
+    cgroup_sample sample = {};
+    sample.usage_ns = std::stoull(read_cgroup_value(cont.cpuacct_dir, "cpuacct.usage"));
+    std::ifstream stat(cont.cpu_dir + "/cpu.stat");
+    std::string key;
+    uint64_t value;
+    while (stat >> key >> value) {
+        if (key == "nr_periods") {
+            sample.nr_periods = value;
+        } else if (key == "nr_throttled") {
+            sample.nr_throttled = value;
+        } else if (key == "throttled_time") {
+            sample.throttled_ns = value;
+        }
+    }
+    for (int worker = 0; worker < workers; ++worker) {
+        sample.spin_loops += cont.progress[worker];
+    }
+    return sample;
+}
+
+// Max-min fair split of cpus between containers which have equal cpu.shares
+// and want min(quota, workers) cpus
+static void compute_expected_cpus(std::vector<bench_container> &conts, int workers, long cpus_count) {
+    std::vector<double> demand;
+    for (bench_container const &cont: conts) {
+        demand.push_back(std::min<double>(cont.cpu_limit / 100.0 * cpus_count, workers));
+    }
+    std::vector<size_t> order(conts.size());
+    for (size_t idx = 0; idx < order.size(); ++idx) {
+        order[idx] = idx;
+    }
+    std::sort(order.begin(), order.end(), [&demand](size_t l, size_t r) { return demand[l] < demand[r]; });
+    double capacity = cpus_count;
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        double const fair = capacity / (order.size() - pos);
+        double const given = std::min(demand[order[pos]], fair);
+        conts[order[pos]].expected_cpus = given;
+        capacity -= given;
+    }
+}
+
+// Spinner joins container cpu and cpuacct cgroups and spins until killed
+static int fork_spinner(bench_container const &cont, int worker) {
+    int const spinner_pid = check_result(fork(), "Failed to fork spinner");
+    if (spinner_pid == 0) {
+        int return_code = 0;
+        try {
+            std::string const pid_str = std::to_string(getpid());
+            write_cgroup_file(cont.cpu_dir, "tasks", pid_str);
+            write_cgroup_file(cont.cpuacct_dir, "tasks", pid_str);
+            while (true) {
+                spin(SPIN_BATCH);
+                cont.progress[worker] += SPIN_BATCH;
+            }
+        } catch(std::exception &e) {
+            std::cerr << "Spinner exception: " << e.what() << std::endl;
+            return_code = EXCEPTION_OCCURED_ERROR;
+        }
+        _exit(return_code);
+    }
+    return spinner_pid;
+}
+
+static void record_interval(bench_container &cont, cgroup_sample const &sample, double seconds,
+                            double loops_per_sec) {
+    double const cpus = (sample.usage_ns - cont.last.usage_ns) / 1e9 / seconds;
+    double const work_cpus = (sample.spin_loops - cont.last.spin_loops) / loops_per_sec / seconds;
+    cont.cpus.push_back(cpus);
+    cont.error_pct.push_back(100 * (cpus - cont.expected_cpus) / cont.expected_cpus);
+    cont.work_error_pct.push_back(100 * (work_cpus - cont.expected_cpus) / cont.expected_cpus);
+    uint64_t const throttled = sample.nr_throttled - cont.last.nr_throttled;
+    if (throttled) {
+        cont.stall_ms.push_back((sample.throttled_ns - cont.last.throttled_ns) / 1e6 / throttled);
+    }
+    cont.periods += sample.nr_periods - cont.last.nr_periods;
+    cont.throttled += throttled;
+    cont.last = sample;
+}
+
+static void print_distribution(std::string const &title, std::vector<double> values, std::string const &unit) {
+    std::sort(values.begin(), values.end());
+    std::cout << "\t" << title << " (" << unit << ", " << values.size() << " samples): "
+              << "p1 " << percentile(values, 1)
+              << " p50 " << percentile(values, 50)
+              << " p99 " << percentile(values, 99)
+              << " max " << (values.empty() ? 0 : values.back()) << std::endl;
+}
+
+static void print_result(bench_container const &cont) {
+    double mean_cpus = 0;
+    for (double cpus: cont.cpus) {
+        mean_cpus += cpus / cont.cpus.size();
+    }
+    std::cout << "container " << cont.pid << " (--cpu " << cont.cpu_limit << ")" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "\texpected cpus: " << cont.expected_cpus << ", achieved: " << mean_cpus
+              << " (" << std::setprecision(1) << 100 * (mean_cpus - cont.expected_cpus) / cont.expected_cpus
+              << "%)" << std::endl;
+    print_distribution("cpuacct error", cont.error_pct, "%");
+    print_distribution("spin progress error", cont.work_error_pct, "%");
+    std::cout << "\tthrottled periods: " << cont.throttled << '/' << cont.periods << " ("
+              << (cont.periods ? 100.0 * cont.throttled / cont.periods : 0) << "%)" << std::endl;
+    print_distribution("throttle stall", cont.stall_ms, "ms");
+}
+
+static void stop_bench(std::vector<bench_container> &conts, bool debug_enabled) {
+    for (bench_container &cont: conts) {
+        for (int spinner_pid: cont.spinner_pids) {
+            kill(spinner_pid, SIGKILL);
+            waitpid(spinner_pid, nullptr, 0);
+        }
+        stop_arguments stop_args;
+        stop_args.pid = cont.pid;
+        stop_args.signal = SIGKILL;
+        stop_args.debug_enabled = debug_enabled;
+        aucont_stop(stop_args);
+        waitpid(cont.pid, nullptr, 0); // started container is our child
+    }
+}
+
+int aucont_bench_cpu(bench_cpu_arguments const &args) {
+    std::vector<bench_container> conts;
+    volatile uint64_t *progress = nullptr;
+    size_t const progress_size = sizeof(uint64_t) * args.cpu_limits.size() * args.workers;
+    try {
+        long const cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
+        double const loops_per_sec = calibrate_spin();
+        if (args.debug_enabled) {
+            printDebug() << "Cpus count is " << cpus_count << std::endl;
+            printDebug() << "Spin speed is " << loops_per_sec << " loops per cpu second" << std::endl;
+        }
+        void *shared = mmap(nullptr, progress_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        check_result(shared == MAP_FAILED ? -1 : 0, "Failed to map spinners progress");
+        progress = static_cast<volatile uint64_t*>(shared);
+
+        for (size_t cont_idx = 0; cont_idx < args.cpu_limits.size(); ++cont_idx) {
+            start_arguments start_args;
+            start_args.image_path = args.image_path;
+            start_args.cmd = args.cmd;
+            start_args.cmd_args = args.cmd_args;
+            start_args.cmd_args_count = args.cmd_args_count;
+            start_args.cpu_limit = args.cpu_limits[cont_idx];
+            start_args.cpu_period_us = args.cpu_period_us;
+            start_args.net_enabled = false;
+            start_args.join_pid = 0;
+            start_args.daemonize = true;
+            start_args.debug_enabled = args.debug_enabled;
+            bench_container cont = {};
+            check_result(aucont_start(start_args, &cont.pid), "Failed to start container",
+                         [](int code) { return code == 0; });
+            cont.cpu_limit = args.cpu_limits[cont_idx];
+            cont.cpu_dir = container_cgroup_dir(CPU_CGROUP_DIR, cont.pid);
+            cont.cpuacct_dir = container_cgroup_dir(CPUACCT_CGROUP_DIR, cont.pid);
+            cont.progress = progress + cont_idx * args.workers;
+            conts.push_back(cont);
+        }
+        compute_expected_cpus(conts, args.workers, cpus_count);
+
+        for (bench_container &cont: conts) {
+            for (int worker = 0; worker < args.workers; ++worker) {
+                cont.spinner_pids.push_back(fork_spinner(cont, worker));
+            }
+        }
+        usleep(args.sample_ms * 1000); // warm up: spinners join cgroups
+        for (bench_container &cont: conts) {
+            cont.last = sample_cgroup(cont, args.workers);
+        }
+
+        auto last_time = bench_clock::now();
+        auto const finish_time = last_time + std::chrono::seconds(args.duration_sec);
+        while (last_time < finish_time) {
+            usleep(args.sample_ms * 1000);
+            auto const now = bench_clock::now();
+            double const seconds = std::chrono::duration<double>(now - last_time).count();
+            last_time = now;
+            for (bench_container &cont: conts) {
+                record_interval(cont, sample_cgroup(cont, args.workers), seconds, loops_per_sec);
+            }
+        }
+
+        std::cout << args.cpu_limits.size() << " containers, " << args.workers << " spinners each, "
+                  << cpus_count << " cpus, " << args.sample_ms << "ms intervals" << std::endl;
+        for (bench_container const &cont: conts) {
+            print_result(cont);
+        }
+        stop_bench(conts, args.debug_enabled);
+        munmap(const_cast<uint64_t*>(progress), progress_size);
+        return 0;
+    } catch(std::exception &e) {
+        stop_bench(conts, args.debug_enabled);
+        if (progress) {
+            munmap(const_cast<uint64_t*>(progress), progress_size);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
@@ -0,0 +1,370 @@
+#include "aucont.h"
+#include "error_codes.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <wait.h>
+
+
+static unsigned short const BENCH_PORT = 5201;
+static char const UDP_END_MARKER = 'E';
+static char const UDP_QUIT_MARKER = 'Q';
+static int const UDP_MARKER_REPEAT = 10;
+static int const SINK_RECV_TIMEOUT_SEC = 5;
+
+typedef std::chrono::steady_clock bench_clock;
+
+// What sink received during throughput phase
+struct sink_report {
+    uint64_t bytes;
+    uint64_t packets;
+};
+
+struct bench_result {
+    sink_report received;
+    uint64_t sent_packets;
+    uint64_t dev_packets; // packets transmitted by host side device
+    double seconds;
+    std::vector<double> rtt_us;
+};
+
+static sockaddr_in make_addr(in_addr_t ip, unsigned short port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip;
+    addr.sin_port = htons(port);
+    return addr;
+}
+
+static void set_recv_timeout(int fd, int seconds) {
+    timeval timeout = {seconds, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+static bool write_all(int fd, char const *data, size_t size) {
+    while (size) {
+        ssize_t written = write(fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char *data, size_t size) {
+    while (size) {
+        ssize_t was_read = read(fd, data, size);
+        if (was_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (was_read <= 0) {
+            return false;
+        }
+        data += was_read;
+        size -= was_read;
+    }
+    return true;
+}
+
+/*Sink side (runs in container net ns)*********/
+
+static void tcp_sink(int listen_fd, size_t msg_size, int report_fd) {
+    std::vector<char> buffer(std::max<size_t>(msg_size, 1 << 16));
+    int conn = check_result(accept(listen_fd, nullptr, nullptr), "Sink failed to accept");
+    sink_report report = {0, 0};
+    ssize_t was_read;
+    while ((was_read = read(conn, buffer.data(), buffer.size())) > 0) {
+        report.bytes += was_read;
+        report.packets += 1;
+    }
+    close(conn);
+    write_all(report_fd, reinterpret_cast<char*>(&report), sizeof(report));
+
+    // Latency phase: echo everything back
+    conn = check_result(accept(listen_fd, nullptr, nullptr), "Sink failed to accept");
+    int no_delay = 1;
+    setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    while ((was_read = read(conn, buffer.data(), buffer.size())) > 0) {
+        if (!write_all(conn, buffer.data(), was_read)) {
+            break;
+        }
+    }
+    close(conn);
+}
+
+static void udp_sink(int fd, size_t msg_size, int report_fd) {
+    std::vector<char> buffer(std::max<size_t>(msg_size, 1 << 16));
+    set_recv_timeout(fd, SINK_RECV_TIMEOUT_SEC);
+    sink_report report = {0, 0};
+    ssize_t was_read;
+    while ((was_read = recv(fd, buffer.data(), buffer.size(), 0)) != -1) {
+        if (was_read == 1 && buffer[0] == UDP_END_MARKER) {
+            break;
+        }
+        report.bytes += was_read;
+        report.packets += 1;
+    }
+    write_all(report_fd, reinterpret_cast<char*>(&report), sizeof(report));
+
+    // Latency phase: echo sequence numbered datagrams back
+    sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    while ((was_read = recvfrom(fd, buffer.data(), buffer.size(), 0,
+                                reinterpret_cast<sockaddr*>(&peer), &peer_len)) != -1) {
+        if (was_read == 1) {
+            if (buffer[0] == UDP_QUIT_MARKER) {
+                break;
+            }
+            continue; // late end markers
+        }
+        sendto(fd, buffer.data(), was_read, 0, reinterpret_cast<sockaddr*>(&peer), peer_len);
+    }
+}
+
+// Forks sink process. If cont_pid != 0 sink enters container user and net ns.
+// Returns sink pid, report_fd gets pipe the sink writes ready byte and sink_report to.
+static int fork_sink(int cont_pid, in_addr_t ip, bench_net_arguments const &args, int &report_fd) {
+    int report_pipe[2];
+    check_result(pipe(report_pipe), "Failed to create sink report pipe");
+    int const sink_pid = check_result(fork(), "Failed to fork sink");
+    if (sink_pid == 0) {
+        close(report_pipe[0]);
+        int return_code = 0;
+        try {
+            if (cont_pid) {
+                std::string const cont_pid_str = std::to_string(cont_pid);
+                set_ns(cont_pid_str, "user");
+                set_ns(cont_pid_str, "net");
+            }
+            int fd = check_result(socket(AF_INET, args.udp ? SOCK_DGRAM : SOCK_STREAM, 0),
+                                  "Failed to create sink socket");
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            sockaddr_in addr = make_addr(ip, BENCH_PORT);
+            check_result(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "Failed to bind sink");
+            if (!args.udp) {
+                check_result(listen(fd, 1), "Failed to listen sink");
+            }
+            char ready = 'r';
+            write_all(report_pipe[1], &ready, 1);
+            if (args.udp) {
+                udp_sink(fd, args.msg_size, report_pipe[1]);
+            } else {
+                tcp_sink(fd, args.msg_size, report_pipe[1]);
+            }
+            close(fd);
+        } catch(std::exception &e) {
+            std::cerr << "Sink exception: " << e.what() << std::endl;
+            return_code = EXCEPTION_OCCURED_ERROR;
+        }
+        _exit(return_code);
+    }
+    close(report_pipe[1]);
+    char ready;
+    check_result(read_all(report_pipe[0], &ready, 1), "Sink failed to start",
+                 [](int ok) { return ok != 0; });
+    report_fd = report_pipe[0];
+    return sink_pid;
+}
+
+/*Blaster side (runs in host net ns)***********/
+
+static uint64_t dev_tx_packets(std::string const &dev) {
+    std::ifstream stat_file("/sys/class/net/" + dev + "/statistics/tx_packets");
+    uint64_t packets = 0;
+    stat_file >> packets;
+    return packets;
+}
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static void tcp_blast(in_addr_t ip, std::string const &dev, bench_net_arguments const &args,
+                      int report_fd, bench_result &result) {
+    std::vector<char> buffer(args.msg_size, 'x');
+    int fd = check_result(socket(AF_INET, SOCK_STREAM, 0), "Failed to create blaster socket");
+    sockaddr_in addr = make_addr(ip, BENCH_PORT);
+    check_result(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "Failed to connect sink");
+    uint64_t const dev_packets_start = dev_tx_packets(dev);
+    auto const start = bench_clock::now();
+    result.sent_packets = 0;
+    while (seconds_since(start) < args.duration_sec) {
+        check_result(write_all(fd, buffer.data(), buffer.size()), "Failed to send to sink",
+                     [](int ok) { return ok != 0; });
+        result.sent_packets += 1;
+    }
+    shutdown(fd, SHUT_WR);
+    check_result(read_all(report_fd, reinterpret_cast<char*>(&result.received), sizeof(result.received)),
+                 "Failed to read sink report", [](int ok) { return ok != 0; });
+    result.seconds = seconds_since(start);
+    result.dev_packets = dev_tx_packets(dev) - dev_packets_start;
+    close(fd);
+
+    fd = check_result(socket(AF_INET, SOCK_STREAM, 0), "Failed to create latency socket");
+    check_result(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "Failed to connect sink");
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    char ping[8] = {0};
+    for (size_t sample = 0; sample < args.latency_samples; ++sample) {
+        auto const sent_at = bench_clock::now();
+        if (!write_all(fd, ping, sizeof(ping)) || !read_all(fd, ping, sizeof(ping))) {
+            break;
+        }
+        result.rtt_us.push_back(seconds_since(sent_at) * 1e6);
+    }
+    close(fd);
+}
+
+static void udp_blast(in_addr_t ip, std::string const &dev, bench_net_arguments const &args,
+                      int report_fd, bench_result &result) {
+    std::vector<char> buffer(args.msg_size, 'x');
+    int fd = check_result(socket(AF_INET, SOCK_DGRAM, 0), "Failed to create blaster socket");
+    sockaddr_in addr = make_addr(ip, BENCH_PORT);
+    check_result(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "Failed to connect sink");
+    uint64_t const dev_packets_start = dev_tx_packets(dev);
+    auto const start = bench_clock::now();
+    result.sent_packets = 0;
+    while (seconds_since(start) < args.duration_sec) {
+        if (send(fd, buffer.data(), buffer.size(), 0) != -1) {
+            result.sent_packets += 1;
+        }
+    }
+    result.seconds = seconds_since(start);
+    result.dev_packets = dev_tx_packets(dev) - dev_packets_start;
+    for (int marker = 0; marker < UDP_MARKER_REPEAT; ++marker) {
+        send(fd, &UDP_END_MARKER, 1, 0);
+        usleep(1000);
+    }
+    check_result(read_all(report_fd, reinterpret_cast<char*>(&result.received), sizeof(result.received)),
+                 "Failed to read sink report", [](int ok) { return ok != 0; });
+
+    set_recv_timeout(fd, 1);
+    uint64_t ping[2] = {0, 0};
+    for (uint64_t sample = 0; sample < args.latency_samples; ++sample) {
+        ping[0] = sample;
+        auto const sent_at = bench_clock::now();
+        if (send(fd, ping, sizeof(ping), 0) == -1) {
+            break;
+        }
+        uint64_t pong[2];
+        ssize_t was_read;
+        do {
+            was_read = recv(fd, pong, sizeof(pong), 0);
+        } while (was_read == sizeof(pong) && pong[0] != sample); // drop late replies
+        if (was_read == sizeof(pong)) {
+            result.rtt_us.push_back(seconds_since(sent_at) * 1e6);
+        }
+    }
+    for (int marker = 0; marker < UDP_MARKER_REPEAT; ++marker) {
+        send(fd, &UDP_QUIT_MARKER, 1, 0);
+    }
+    close(fd);
+}
+
+static void print_result(std::string const &title, bench_net_arguments const &args, bench_result &result) {
+    std::sort(result.rtt_us.begin(), result.rtt_us.end());
+    double const gbits = result.received.bytes * 8 / result.seconds / 1e9;
+    double const pps = result.dev_packets / result.seconds;
+    std::cout << title << " (" << (args.udp ? "udp" : "tcp") << ", " << args.msg_size << " bytes messages)"
+              << std::endl << std::fixed << std::setprecision(3)
+              << "\tthroughput: " << gbits << " Gbit/s" << std::endl
+              << "\trate: " << std::setprecision(0) << pps << " packets/s" << std::endl;
+    if (args.udp && result.sent_packets) {
+        std::cout << "\tlost: " << std::setprecision(2)
+                  << 100.0 * (result.sent_packets - std::min(result.sent_packets, result.received.packets)) /
+                     result.sent_packets << '%' << std::endl;
+    }
+    std::cout << "\tlatency (rtt, us, " << result.rtt_us.size() << " samples): " << std::setprecision(1)
+              << "p50 " << percentile(result.rtt_us, 50)
+              << " p90 " << percentile(result.rtt_us, 90)
+              << " p99 " << percentile(result.rtt_us, 99)
+              << " p99.9 " << percentile(result.rtt_us, 99.9)
+              << " max " << (result.rtt_us.empty() ? 0 : result.rtt_us.back()) << std::endl;
+}
+
+static void run_bench(std::string const &title, int cont_pid, in_addr_t ip, std::string const &dev,
+                      bench_net_arguments const &args) {
+    int report_fd;
+    int const sink_pid = fork_sink(cont_pid, ip, args, report_fd);
+    bench_result result;
+    try {
+        if (args.udp) {
+            udp_blast(ip, dev, args, report_fd, result);
+        } else {
+            tcp_blast(ip, dev, args, report_fd, result);
+        }
+    } catch(...) {
+        kill(sink_pid, SIGKILL);
+        waitpid(sink_pid, nullptr, 0);
+        close(report_fd);
+        throw;
+    }
+    waitpid(sink_pid, nullptr, 0);
+    close(report_fd);
+    print_result(title, args, result);
+}
+
+static void stop_container(int cont_pid, bool debug_enabled) {
+    stop_arguments stop_args;
+    stop_args.pid = cont_pid;
+    stop_args.signal = SIGKILL;
+    stop_args.debug_enabled = debug_enabled;
+    aucont_stop(stop_args);
+    waitpid(cont_pid, nullptr, 0); // started container is our child
+}
+
+int aucont_bench_net(bench_net_arguments const &args) {
+    int cont_pid = 0;
+    try {
+        start_arguments start_args;
+        start_args.image_path = args.image_path;
+        start_args.cmd = args.cmd;
+        start_args.cmd_args = args.cmd_args;
+        start_args.cmd_args_count = args.cmd_args_count;
+        start_args.cpu_limit = 100;
+        start_args.cont_ip = args.cont_ip;
+        start_args.host_ip = args.host_ip;
+        start_args.net_enabled = true;
+        start_args.net_mode = NET_MODE_VETH;
+        start_args.join_pid = 0;
+        start_args.net_queues = args.net_queues;
+        start_args.mtu = args.mtu;
+        start_args.offloads = args.offloads;
+        start_args.daemonize = true;
+        start_args.debug_enabled = args.debug_enabled;
+        check_result(aucont_start(start_args, &cont_pid), "Failed to start container",
+                     [](int code) { return code == 0; });
+        sleep(1); // let container bring its interface up
+
+        std::string const net_id = "Net" + std::to_string(getpid()); // same as in aucont_start
+        if (args.baseline) {
+            run_bench("host loopback", 0, htonl(INADDR_LOOPBACK), "lo", args);
+        }
+        run_bench("host -> container veth", cont_pid, args.cont_ip, "u-" + net_id + "-0", args);
+
+        stop_container(cont_pid, args.debug_enabled);
+        return 0;
+    } catch(std::exception &e) {
+        if (cont_pid) {
+            stop_container(cont_pid, args.debug_enabled);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
@@ -0,0 +1,365 @@
+#include "aucont.h"
+#include "error_codes.h"
+#include "registry.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <signal.h>
+#include <wait.h>
+
+
+static int const PID_SEQ_BASE = 1000000; // fake pid is (client + 1) * PID_SEQ_BASE + seq
+static int const WATCHDOG_POLL_MS = 100;
+static int const REMOVE_KILL_ROUNDS = 200;
+static int const REMOVE_KILL_RECORDS = 64;
+static int const REMOVE_KILL_MAX_DELAY_US = 3000;
+
+typedef std::chrono::steady_clock bench_clock;
+
+enum op_type_t : uint8_t {
+    OP_NONE,
+    OP_PUSH,
+    OP_REMOVE,
+    OP_LIST
+};
+
+// Client progress through each fake pid, the state of a pid whose operation
+// was interrupted by kill -9 is ambiguous
+enum pid_state_t : uint8_t {
+    PID_UNUSED,
+    PID_PUSHING,
+    PID_PUSHED,
+    PID_REMOVING,
+    PID_REMOVED
+};
+
+struct op_sample {
+    op_type_t type;
+    float latency_us;
+    float lock_wait_us;
+};
+
+// Lives in memory shared by bench and clients
+struct client_state {
+    volatile uint64_t ops_done;
+    volatile uint64_t bad_reads; // list returned pid which can't be in registry
+    volatile uint64_t failed_removes; // pushed pid wasn't found
+    volatile bool finished;
+};
+
+struct shared_state {
+    client_state *clients;
+    pid_state_t *pids; // clients * ops
+    op_sample *samples; // clients * ops
+    size_t size;
+};
+
+static int fake_pid(int client, int seq) {
+    return (client + 1) * PID_SEQ_BASE + seq;
+}
+
+static container_record fake_record(int client, int seq) {
+    container_record record = {};
+    record.pid = fake_pid(client, seq);
+    char id[sizeof(record.id)];
+    snprintf(id, sizeof(id), "%012x", record.pid);
+    set_record_field(record.id, id);
+    set_record_field(record.image, "/bench/image");
+    set_record_field(record.cmd, "/bench/cmd");
+    return record;
+}
+
+static bool valid_fake_pid(int pid, bench_registry_arguments const &args) {
+    return pid >= PID_SEQ_BASE && pid / PID_SEQ_BASE <= args.clients && pid % PID_SEQ_BASE < args.ops;
+}
+
+// Client pushes fake pids and then randomly removes its own pushed pids or
+// lists the whole registry like aucont_list
+static void run_client(int client, bench_registry_arguments const &args, shared_state const &shared) {
+    container_registry registry(args.file_name);
+    client_state &state = shared.clients[client];
+    pid_state_t *pid_states = shared.pids + client * args.ops;
+    op_sample *samples = shared.samples + client * args.ops;
+    std::mt19937 random(client);
+    std::vector<int> pushed;
+    int next_seq = 0;
+    for (int op = 0; op < args.ops; ++op) {
+        int const dice = random() % 100;
+        op_sample &sample = samples[op];
+        uint64_t const wait_before = registry.lock_wait_ns();
+        auto const started = bench_clock::now();
+        if (dice < args.list_percent) {
+            sample.type = OP_LIST;
+            for (container_record const &record: registry.records()) {
+                if (!valid_fake_pid(record.pid, args)) {
+                    state.bad_reads += 1;
+                }
+            }
+        } else if (pushed.empty() || dice < args.list_percent + (100 - args.list_percent) / 2) {
+            sample.type = OP_PUSH;
+            int const seq = next_seq++;
+            pid_states[seq] = PID_PUSHING;
+            registry.add(fake_record(client, seq));
+            pid_states[seq] = PID_PUSHED;
+            pushed.push_back(seq);
+        } else {
+            sample.type = OP_REMOVE;
+            size_t const pushed_idx = random() % pushed.size();
+            int const seq = pushed[pushed_idx];
+            pushed[pushed_idx] = pushed.back();
+            pushed.pop_back();
+            pid_states[seq] = PID_REMOVING;
+            if (!registry.remove_by_pid(fake_pid(client, seq))) {
+                state.failed_removes += 1;
+            }
+            pid_states[seq] = PID_REMOVED;
+        }
+        sample.latency_us = std::chrono::duration<float, std::micro>(bench_clock::now() - started).count();
+        sample.lock_wait_us = (registry.lock_wait_ns() - wait_before) / 1e3;
+        state.ops_done += 1;
+    }
+    state.finished = true;
+}
+
+static shared_state map_shared_state(bench_registry_arguments const &args) {
+    size_t const ops = static_cast<size_t>(args.clients) * args.ops;
+    shared_state shared;
+    shared.size = sizeof(client_state) * args.clients + (sizeof(pid_state_t) + sizeof(op_sample)) * ops;
+    void *memory = mmap(nullptr, shared.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    check_result(memory == MAP_FAILED ? -1 : 0, "Failed to map clients state");
+    shared.clients = static_cast<client_state*>(memory);
+    shared.samples = reinterpret_cast<op_sample*>(shared.clients + args.clients);
+    shared.pids = reinterpret_cast<pid_state_t*>(shared.samples + ops);
+    return shared;
+}
+
+static uint64_t total_ops(bench_registry_arguments const &args, shared_state const &shared) {
+    uint64_t ops = 0;
+    for (int client = 0; client < args.clients; ++client) {
+        ops += shared.clients[client].ops_done;
+    }
+    return ops;
+}
+
+// Waits for clients killing random ones. Returns false if registry stopped
+// making progress: killed client held the lock.
+static bool wait_clients(bench_registry_arguments const &args, std::vector<int> &client_pids,
+                         std::vector<bool> &killed, shared_state const &shared) {
+    std::mt19937 random(args.clients);
+    uint64_t const expected_ops = static_cast<uint64_t>(args.clients) * args.ops;
+    std::vector<uint64_t> kill_at; // kill next victim after this many ops
+    for (int victim = 0; victim < args.kills; ++victim) {
+        kill_at.push_back(random() % (expected_ops / 2 + 1));
+    }
+    std::sort(kill_at.begin(), kill_at.end(), std::greater<uint64_t>());
+
+    int running = args.clients;
+    uint64_t last_ops = 0;
+    auto last_progress = bench_clock::now();
+    while (running) {
+        usleep(WATCHDOG_POLL_MS * 1000);
+        uint64_t const ops = total_ops(args, shared);
+        while (!kill_at.empty() && ops >= kill_at.back()) {
+            kill_at.pop_back();
+            int const victim = random() % args.clients;
+            if (!killed[victim] && !shared.clients[victim].finished) {
+                kill(client_pids[victim], SIGKILL);
+                killed[victim] = true;
+            }
+        }
+        int status;
+        while (waitpid(-1, &status, WNOHANG) > 0) {
+            running -= 1;
+        }
+        if (ops != last_ops) {
+            last_ops = ops;
+            last_progress = bench_clock::now();
+        } else if (bench_clock::now() - last_progress > std::chrono::seconds(args.watchdog_sec)) {
+            for (int client = 0; client < args.clients; ++client) {
+                kill(client_pids[client], SIGKILL);
+            }
+            while (wait(nullptr) > 0) {
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compares registry content with pids clients pushed and didn't remove
+static void check_registry(bench_registry_arguments const &args, shared_state const &shared,
+                           std::vector<bool> const &killed) {
+    std::multiset<int> registry;
+    for (container_record const &record: container_registry(args.file_name).records()) {
+        registry.insert(record.pid);
+    }
+
+    size_t duplicates = 0, lost = 0, ghosts = 0, ambiguous = 0;
+    for (int client = 0; client < args.clients; ++client) {
+        for (int seq = 0; seq < args.ops; ++seq) {
+            pid_state_t const state = shared.pids[client * args.ops + seq];
+            size_t const count = registry.count(fake_pid(client, seq));
+            duplicates += count > 1 ? count - 1 : 0;
+            if (state == PID_PUSHING || state == PID_REMOVING) {
+                ambiguous += killed[client] ? 1 : 0;
+                ghosts += killed[client] ? 0 : count;
+            } else if (state == PID_PUSHED) {
+                lost += count == 0 ? 1 : 0;
+            } else {
+                ghosts += count ? 1 : 0;
+            }
+        }
+    }
+    size_t unknown = 0;
+    for (int registry_pid: registry) {
+        unknown += valid_fake_pid(registry_pid, args) ? 0 : 1;
+    }
+    uint64_t bad_reads = 0, failed_removes = 0;
+    for (int client = 0; client < args.clients; ++client) {
+        bad_reads += shared.clients[client].bad_reads;
+        failed_removes += shared.clients[client].failed_removes;
+    }
+    std::cout << "correctness (" << registry.size() << " pids left): "
+              << "lost " << lost << ", duplicates " << duplicates << ", removed but present " << ghosts
+              << ", garbage " << unknown << ", bad reads " << bad_reads << ", failed removes " << failed_removes
+              << ", ambiguous after kill " << ambiguous << std::endl;
+}
+
+// Kills a client in the middle of removals, which rewrite record array: the
+// registry must stay readable and hold no record twice. Client removes
+// records one by one and in batches, so both removals are interrupted.
+static void check_kill_during_remove(bench_registry_arguments const &args) {
+    std::mt19937 random(args.kills);
+    size_t duplicates = 0, garbage = 0, invalid = 0, removed = 0;
+    for (int round = 0; round < REMOVE_KILL_ROUNDS; ++round) {
+        unlink(args.file_name.c_str());
+        std::vector<container_record> records;
+        {
+            container_registry registry(args.file_name);
+            for (int seq = 0; seq < REMOVE_KILL_RECORDS; ++seq) {
+                records.push_back(fake_record(0, seq));
+                registry.add(records.back());
+            }
+        }
+        int const client_pid = check_result(fork(), "Failed to fork client");
+        if (client_pid == 0) {
+            container_registry registry(args.file_name);
+            for (size_t record_idx = 0; record_idx < records.size(); record_idx += 2) {
+                registry.remove_by_pid(records[record_idx].pid);
+                registry.remove_records({records[record_idx + 1]});
+            }
+            _exit(0);
+        }
+        usleep(random() % REMOVE_KILL_MAX_DELAY_US);
+        kill(client_pid, SIGKILL);
+        waitpid(client_pid, nullptr, 0);
+
+        try {
+            std::multiset<int> registry;
+            for (container_record const &record: container_registry(args.file_name).records()) {
+                registry.insert(record.pid);
+            }
+            for (int pid: registry) {
+                garbage += valid_fake_pid(pid, args) ? 0 : 1;
+            }
+            for (container_record const &record: records) {
+                size_t const count = registry.count(record.pid);
+                duplicates += count > 1 ? count - 1 : 0;
+            }
+            removed += records.size() - registry.size();
+        } catch(aucont_exception &) {
+            invalid += 1;
+        }
+    }
+    std::cout << "kill during remove (" << REMOVE_KILL_ROUNDS << " rounds, " << removed << " records removed): "
+              << "duplicates " << duplicates << ", garbage " << garbage << ", invalid registry " << invalid
+              << std::endl;
+}
+
+static void print_latencies(std::string const &title, op_type_t type, bench_registry_arguments const &args,
+                            shared_state const &shared) {
+    std::vector<double> latency, wait;
+    size_t const ops = static_cast<size_t>(args.clients) * args.ops;
+    for (size_t op = 0; op < ops; ++op) {
+        if (shared.samples[op].type == type) {
+            latency.push_back(shared.samples[op].latency_us);
+            wait.push_back(shared.samples[op].lock_wait_us);
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    std::sort(wait.begin(), wait.end());
+    std::cout << "\t" << title << " (" << latency.size() << " ops, us): latency p50 " << percentile(latency, 50)
+              << " p99 " << percentile(latency, 99) << " max " << (latency.empty() ? 0 : latency.back())
+              << "; lock wait p50 " << percentile(wait, 50) << " p99 " << percentile(wait, 99) << std::endl;
+}
+
+int aucont_bench_registry(bench_registry_arguments const &args) {
+    shared_state shared = {};
+    try {
+        unlink(args.file_name.c_str());
+        shared = map_shared_state(args);
+
+        auto const started = bench_clock::now();
+        std::vector<int> client_pids;
+        std::vector<bool> killed(args.clients, false);
+        for (int client = 0; client < args.clients; ++client) {
+            int const client_pid = fork();
+            if (client_pid == -1) {
+                for (int started_pid: client_pids) {
+                    kill(started_pid, SIGKILL);
+                    waitpid(started_pid, nullptr, 0);
+                }
+                throw aucont_exception("Failed to fork client");
+            }
+            if (client_pid == 0) {
+                int return_code = 0;
+                try {
+                    run_client(client, args, shared);
+                } catch(std::exception &e) {
+                    std::cerr << "Client exception: " << e.what() << std::endl;
+                    return_code = EXCEPTION_OCCURED_ERROR;
+                }
+                _exit(return_code);
+            }
+            client_pids.push_back(client_pid);
+        }
+        bool const progressed = wait_clients(args, client_pids, killed, shared);
+        double const seconds = std::chrono::duration<double>(bench_clock::now() - started).count();
+
+        uint64_t const ops = total_ops(args, shared);
+        std::cout << args.clients << " clients, " << args.ops << " ops each, "
+                  << std::count(killed.begin(), killed.end(), true) << " killed" << std::endl
+                  << std::fixed << std::setprecision(1)
+                  << "throughput: " << ops / seconds << " ops/s (" << ops << " ops in " << seconds << "s)"
+                  << std::endl;
+        print_latencies("push_back", OP_PUSH, args, shared);
+        print_latencies("remove_by_pid", OP_REMOVE, args, shared);
+        print_latencies("list", OP_LIST, args, shared);
+        if (progressed) {
+            check_registry(args, shared, killed);
+            if (args.kills) {
+                check_kill_during_remove(args);
+            }
+        } else {
+            std::cout << "DEADLOCK: no progress for " << args.watchdog_sec << "s (killed client held "
+                      << "the registry lock)" << std::endl;
+        }
+
+        munmap(shared.clients, shared.size);
+        unlink(args.file_name.c_str());
+        return progressed ? 0 : EXCEPTION_OCCURED_ERROR;
+    } catch(std::exception &e) {
+        if (shared.clients) {
+            munmap(shared.clients, shared.size);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
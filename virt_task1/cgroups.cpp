@@ -0,0 +1,109 @@
+#include "cgroups.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+std::string const CGROUP_DIR = "/tmp/aucont/cgroup";
+std::string const CPU_CGROUP_DIR = CGROUP_DIR + "/cpu";
+std::string const MEMORY_CGROUP_DIR = CGROUP_DIR + "/memory";
+std::string const HUGETLB_CGROUP_DIR = CGROUP_DIR + "/hugetlb";
+std::string const CPUACCT_CGROUP_DIR = CGROUP_DIR + "/cpuacct";
+std::string const BLKIO_CGROUP_DIR = CGROUP_DIR + "/blkio";
+std::string const FREEZER_CGROUP_DIR = CGROUP_DIR + "/freezer";
+std::string const PERF_EVENT_CGROUP_DIR = CGROUP_DIR + "/perf_event";
+
+long const DEFAULT_CPU_PERIOD_US = 100 * 1000; // 100ms
+long const MIN_CPU_QUOTA_US = 1000;
+unsigned long long const IDLE_USAGE_NS_PER_SEC = 10 * 1000 * 1000;
+
+
+void mount_cgroup(std::string const &base_dir, std::string const &cgroup) {
+    static int const ALREADY_MOUNTED_ERR = 8192;
+    std::string cgroup_dir = base_dir + '/' + cgroup;
+    std::string exec_str = "sudo mount -t cgroup " + cgroup + " -o " + cgroup + " " + cgroup_dir +
+            "  > /dev/null 2>&1";
+    exec_check_result("mkdir -p " + cgroup_dir);
+    check_result(system(exec_str.c_str()), "Failed to execute mount command:\n\t'" +
+                 exec_str + '\'', [](int err) { return err == 0 || err == ALREADY_MOUNTED_ERR;});
+}
+
+void write_cgroup_file(std::string const &cgroup_dir, std::string const &file, std::string const &value) {
+    exec_check_result("echo " + value + " | sudo tee " + cgroup_dir + "/" + file + " > /dev/null");
+}
+
+std::string cgroup_dir_of(std::string const &controller_dir, std::string const &slice, std::string const &pid_str) {
+    return controller_dir + (slice.empty() ? "" : "/" + slice) + "/" + pid_str;
+}
+
+std::string container_cgroup_dir(std::string const &controller_dir, int pid) {
+    std::string const pid_str = std::to_string(pid);
+    std::string const controller = controller_dir.substr(controller_dir.rfind('/') + 1);
+    std::ifstream cgroups("/proc/" + pid_str + "/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) { // hierarchy-ID:controller-list:path
+        size_t const controllers_begin = line.find(':') + 1;
+        size_t const path_begin = line.find(':', controllers_begin) + 1;
+        if (controllers_begin == 0 || path_begin == 0) {
+            continue;
+        }
+        std::string const controllers = "," + line.substr(controllers_begin, path_begin - controllers_begin - 1) + ",";
+        if (controllers.find("," + controller + ",") == std::string::npos) {
+            continue;
+        }
+        std::string const path = line.substr(path_begin);
+        std::string const pid_suffix = "/" + pid_str;
+        if (path.size() < pid_suffix.size() ||
+                path.compare(path.size() - pid_suffix.size(), pid_suffix.size(), pid_suffix) != 0) {
+            break;
+        }
+        return controller_dir + path;
+    }
+    throw aucont_exception("Process " + pid_str + " is not in " + controller + " cgroup of aucont container");
+}
+
+std::string read_cgroup_value(std::string const &cgroup_dir, std::string const &file) {
+    std::ifstream value_file(cgroup_dir + "/" + file);
+    std::string value;
+    if (!(value_file >> value)) {
+        throw aucont_exception("Failed to read " + cgroup_dir + "/" + file);
+    }
+    return value;
+}
+
+bool cgroup_has_tasks(std::string const &cgroup_dir) {
+    std::ifstream tasks(cgroup_dir + "/tasks");
+    int task;
+    return static_cast<bool>(tasks >> task);
+}
+
+long cpu_quota_us(int cpu_limit, long period_us) {
+    long const cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
+    return std::max(period_us * cpu_limit * cpus_count / 100, MIN_CPU_QUOTA_US);
+}
+
+void apply_cgroup_writes(std::vector<cgroup_write> const &writes, bool debug_enabled) {
+    size_t written = 0;
+    try {
+        for (; written < writes.size(); ++written) {
+            cgroup_write const &write = writes[written];
+            if (debug_enabled) {
+                printDebug() << write.file << ": " << write.old_value << " -> " << write.value << std::endl;
+            }
+            write_cgroup_file(write.dir, write.file, write.value);
+        }
+    } catch(aucont_exception &) {
+        while (written-- > 0) {
+            cgroup_write const &write = writes[written];
+            try {
+                write_cgroup_file(write.dir, write.file, write.old_value);
+            } catch(aucont_exception &e) {
+                std::cerr << "Failed to roll back " << write.file << ": " << e.what() << std::endl;
+            }
+        }
+        throw;
+    }
+}
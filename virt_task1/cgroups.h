@@ -0,0 +1,52 @@
+#ifndef CGROUPS_H
+#define CGROUPS_H
+#include <string>
+#include <vector>
+
+// cgroup v1 hierarchies are mounted to CGROUP_DIR/CONTROLLER
+extern std::string const CGROUP_DIR;
+extern std::string const CPU_CGROUP_DIR;
+extern std::string const MEMORY_CGROUP_DIR;
+extern std::string const HUGETLB_CGROUP_DIR;
+extern std::string const CPUACCT_CGROUP_DIR;
+extern std::string const BLKIO_CGROUP_DIR;
+extern std::string const FREEZER_CGROUP_DIR;
+extern std::string const PERF_EVENT_CGROUP_DIR;
+
+void mount_cgroup(std::string const &base_dir, std::string const &cgroup);
+
+// Writes value to control file of cgroup (cgroup dirs are owned by root)
+void write_cgroup_file(std::string const &cgroup_dir, std::string const &file, std::string const &value);
+
+// Reads first word of control file, throws aucont_exception if it can't be read
+std::string read_cgroup_value(std::string const &cgroup_dir, std::string const &file);
+
+// Containers get cgroup dirs named by pid in every hierarchy, containers of
+// slices are nested into slice dirs: CONTROLLER/SLICE/PID
+std::string cgroup_dir_of(std::string const &controller_dir, std::string const &slice, std::string const &pid_str);
+
+// Finds cgroup dir of running container in hierarchy mounted at controller_dir
+std::string container_cgroup_dir(std::string const &controller_dir, int pid);
+
+bool cgroup_has_tasks(std::string const &cgroup_dir);
+
+extern long const DEFAULT_CPU_PERIOD_US;
+extern long const MIN_CPU_QUOTA_US; // kernel rejects smaller quotas
+
+// Container using less cpuacct.usage per second is idle: 1% of one cpu
+extern unsigned long long const IDLE_USAGE_NS_PER_SEC;
+
+// cpu.cfs_quota_us for percent of all cpus
+long cpu_quota_us(int cpu_limit, long period_us);
+
+struct cgroup_write {
+    std::string dir;
+    std::string file;
+    std::string value;
+    std::string old_value;
+};
+
+// Writes new values in order, already written values are restored on failure
+void apply_cgroup_writes(std::vector<cgroup_write> const &writes, bool debug_enabled);
+
+#endif // CGROUPS_H
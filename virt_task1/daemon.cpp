@@ -0,0 +1,373 @@
+#include "aucont.h"
+#include "cgroups.h"
+#include "error_codes.h"
+#include "events.h"
+#include "registry.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+typedef std::chrono::steady_clock daemon_clock;
+
+// Soft limits of idle containers saved by daemon, restored by the next one if it was killed
+static std::string const DAEMON_STATE_DIR = "/tmp/aucont/daemon";
+
+static volatile sig_atomic_t daemon_stopping = 0;
+
+// Pressure is percent of time some container tasks were stalled. PSI files
+// exist only for cgroup v2, in v1 hierarchies it is approximated: cpu by
+// percent of throttled periods, memory by hitting the limit (failcnt).
+struct pressure_counters {
+    bool cpu_psi;
+    bool memory_psi;
+    uint64_t cpu_stall_us; // PSI "some" total
+    uint64_t memory_stall_us;
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+    uint64_t memory_failcnt;
+    uint64_t cpu_usage_ns; // cpuacct.usage
+};
+
+struct controlled_container {
+    container_record record;
+    std::string cpu_dir;
+    std::string cpuacct_dir;
+    std::string memory_dir;
+    pressure_counters last;
+    daemon_clock::time_point last_time;
+    double idle_sec;
+    bool reclaim_exhausted; // kernel couldn't reclaim more, wait for activity
+    std::string busy_soft_limit; // soft limit before container became idle, empty - not lowered
+};
+
+// "some avg10=0.00 avg60=0.00 avg300=0.00 total=N" line of .pressure file
+static bool read_psi_total_us(std::string const &file_name, uint64_t &total_us) {
+    std::ifstream pressure_file(file_name);
+    std::string line;
+    while (std::getline(pressure_file, line)) {
+        size_t const total_pos = line.find("total=");
+        if (line.compare(0, 5, "some ") == 0 && total_pos != std::string::npos) {
+            total_us = std::stoull(line.substr(total_pos + 6));
+            return true;
+        }
+    }
+    return false;
+}
+
+static pressure_counters read_pressure(controlled_container const &cont) {
+    pressure_counters counters = {};
+    counters.cpu_psi = read_psi_total_us(cont.cpu_dir + "/cpu.pressure", counters.cpu_stall_us);
+    counters.memory_psi = read_psi_total_us(cont.memory_dir + "/memory.pressure", counters.memory_stall_us);
+    std::ifstream stat(cont.cpu_dir + "/cpu.stat");
+    std::string key;
+    uint64_t value;
+    while (stat >> key >> value) {
+        if (key == "nr_periods") {
+            counters.nr_periods = value;
+        } else if (key == "nr_throttled") {
+            counters.nr_throttled = value;
+        }
+    }
+    counters.memory_failcnt = std::stoull(read_cgroup_value(cont.memory_dir, "memory.failcnt"));
+    counters.cpu_usage_ns = std::stoull(read_cgroup_value(cont.cpuacct_dir, "cpuacct.usage"));
+    return counters;
+}
+
+static double cpu_pressure(pressure_counters const &from, pressure_counters const &to, double seconds) {
+    if (to.cpu_psi) {
+        return std::min(100.0, (to.cpu_stall_us - from.cpu_stall_us) / 1e4 / seconds);
+    }
+    uint64_t const periods = to.nr_periods - from.nr_periods;
+    return periods ? 100.0 * (to.nr_throttled - from.nr_throttled) / periods : 0;
+}
+
+static double memory_pressure(pressure_counters const &from, pressure_counters const &to, double seconds) {
+    if (to.memory_psi) {
+        return std::min(100.0, (to.memory_stall_us - from.memory_stall_us) / 1e4 / seconds);
+    }
+    return to.memory_failcnt != from.memory_failcnt ? 100 : 0;
+}
+
+// Multiplicative step towards pressure target: grow if pressure is above it,
+// shrink if pressure is well below it and usage leaves headroom, never below
+// current usage plus step
+static double next_limit(double limit, double usage, double pressure, int target, int step_percent,
+                         double min_limit, double max_limit) {
+    double const step = step_percent / 100.0;
+    double next = limit;
+    if (pressure > target) {
+        next = limit * (1 + step);
+    } else if (pressure < target / 2.0 && usage < limit * (1 - step)) {
+        next = std::max(limit * (1 - step), usage * (1 + step));
+    }
+    return std::min(std::max(next, min_limit), max_limit);
+}
+
+static std::string saved_soft_limit_file(controlled_container const &cont) {
+    return DAEMON_STATE_DIR + "/" + cont.record.id + ".soft_limit";
+}
+
+// Idle container soft limit is dropped to 0: global reclaim takes idle
+// containers' memory before busy ones'. The busy one is saved to a file too.
+static void demote_soft_limit(controlled_container &cont, daemon_arguments const &args) {
+    if (!cont.busy_soft_limit.empty()) {
+        return;
+    }
+    cont.busy_soft_limit = read_cgroup_value(cont.memory_dir, "memory.soft_limit_in_bytes");
+    mkdir(DAEMON_STATE_DIR.c_str(), 0777);
+    std::ofstream saved(saved_soft_limit_file(cont));
+    if (!(saved << cont.busy_soft_limit << std::flush)) {
+        throw aucont_exception("Failed to save soft limit of container " + std::to_string(cont.record.pid));
+    }
+    apply_cgroup_writes({{cont.memory_dir, "memory.soft_limit_in_bytes", "0", cont.busy_soft_limit}},
+                        args.debug_enabled);
+}
+
+static void restore_soft_limit(controlled_container &cont, daemon_arguments const &args) {
+    if (cont.busy_soft_limit.empty()) {
+        return;
+    }
+    apply_cgroup_writes({{cont.memory_dir, "memory.soft_limit_in_bytes", cont.busy_soft_limit, "0"}},
+                        args.debug_enabled);
+    cont.busy_soft_limit.clear();
+    unlink(saved_soft_limit_file(cont).c_str());
+}
+
+// Reclaims reclaim_percent of usage, but not below memory_min. The hard limit
+// is lowered to the target: kernel reclaims down to it or, if it can't, fails
+// the write with EBUSY (cgroup v1 doesn't OOM-kill on limit write), then the
+// limit is restored. Charges failed meanwhile are caused by us, so failcnt
+// is sampled again and they don't count as memory pressure.
+static void reclaim_container(controlled_container &cont, daemon_arguments const &args) {
+    demote_soft_limit(cont, args);
+    unsigned long long const usage = std::stoull(read_cgroup_value(cont.memory_dir, "memory.usage_in_bytes"));
+    if (cont.reclaim_exhausted || usage <= args.memory_min) {
+        return;
+    }
+    unsigned long long const target = std::max(usage - usage / 100 * args.reclaim_percent, args.memory_min);
+    std::string const limit = read_cgroup_value(cont.memory_dir, "memory.limit_in_bytes");
+    try {
+        write_cgroup_file(cont.memory_dir, "memory.limit_in_bytes", std::to_string(target));
+    } catch(aucont_exception &e) { // EBUSY: nothing cold is left
+        cont.reclaim_exhausted = true;
+        if (args.debug_enabled) {
+            printDebug() << "Reclaim of container " << cont.record.pid << " stopped: " << e.what() << std::endl;
+        }
+    }
+    write_cgroup_file(cont.memory_dir, "memory.limit_in_bytes", limit);
+    cont.last.memory_failcnt = std::stoull(read_cgroup_value(cont.memory_dir, "memory.failcnt"));
+    unsigned long long const reclaimed_usage =
+            std::stoull(read_cgroup_value(cont.memory_dir, "memory.usage_in_bytes"));
+    if (reclaimed_usage < usage) {
+        publish_event("reclaim", cont.record, "\"reclaimed\":" + std::to_string(usage - reclaimed_usage) +
+                      ",\"usage\":" + std::to_string(reclaimed_usage));
+        if (args.debug_enabled) {
+            printDebug() << "Reclaimed " << usage - reclaimed_usage << " bytes of container " << cont.record.pid
+                         << std::endl;
+        }
+    }
+}
+
+// Busy container gets its soft limit back
+static void track_idle(controlled_container &cont, daemon_arguments const &args, uint64_t usage_ns, double seconds) {
+    if (usage_ns < IDLE_USAGE_NS_PER_SEC * seconds) {
+        cont.idle_sec += seconds;
+        return;
+    }
+    cont.idle_sec = 0;
+    cont.reclaim_exhausted = false;
+    restore_soft_limit(cont, args);
+}
+
+// Child quota can't exceed its parent's one (slice), kernel rejects it with EINVAL
+static double slice_cpu_limit(controlled_container const &cont, long cpus_count) {
+    std::string const slice_dir = cont.cpu_dir.substr(0, cont.cpu_dir.rfind('/'));
+    if (slice_dir == CPU_CGROUP_DIR) {
+        return 100;
+    }
+    long long const quota = std::stoll(read_cgroup_value(slice_dir, "cpu.cfs_quota_us"));
+    long const period = std::stol(read_cgroup_value(slice_dir, "cpu.cfs_period_us"));
+    return quota == -1 ? 100 : std::min(100.0, 100.0 * quota / period / cpus_count);
+}
+
+static void control_container(controlled_container &cont, daemon_arguments const &args, long cpus_count) {
+    pressure_counters const now = read_pressure(cont);
+    auto const now_time = daemon_clock::now();
+    double const seconds = std::chrono::duration<double>(now_time - cont.last_time).count();
+    double const cpu_pct = cpu_pressure(cont.last, now, seconds);
+    double const memory_pct = memory_pressure(cont.last, now, seconds);
+    double const cpu_usage = (now.cpu_usage_ns - cont.last.cpu_usage_ns) / 1e9 / seconds / cpus_count * 100;
+    uint64_t const usage_ns = now.cpu_usage_ns - cont.last.cpu_usage_ns;
+    cont.last = now;
+    cont.last_time = now_time;
+    if (args.reclaim_idle_sec) { // after counters are sampled: reclaim resamples failcnt
+        track_idle(cont, args, usage_ns, seconds);
+        if (cont.idle_sec >= args.reclaim_idle_sec && memory_pct == 0) {
+            reclaim_container(cont, args);
+        }
+    }
+    if (!args.control_limits) {
+        return;
+    }
+
+    std::vector<cgroup_write> writes;
+    int record_cpu_limit = -1; // unchanged
+    unsigned long long record_memory_limit = 0;
+    std::ostringstream fields;
+    fields << std::fixed << std::setprecision(1) << "\"reason\":\"pressure\",\"cpu_pressure\":" << cpu_pct
+           << ",\"memory_pressure\":" << memory_pct;
+
+    // Limit is stepped in quota microseconds: whole percents would round
+    // small steps of small limits away, and such limits would never change
+    std::string const quota = read_cgroup_value(cont.cpu_dir, "cpu.cfs_quota_us");
+    if (quota != "-1") { // containers without quota aren't limited by us either
+        long const period_us = std::stol(read_cgroup_value(cont.cpu_dir, "cpu.cfs_period_us"));
+        long long const quota_us = std::stoll(quota);
+        double const cpu_limit = 100.0 * quota_us / period_us / cpus_count;
+        double const max_cpu_limit = std::min<double>(args.cpu_max, slice_cpu_limit(cont, cpus_count));
+        double const next_cpu_limit = next_limit(cpu_limit, cpu_usage, cpu_pct, args.cpu_target, args.step_percent,
+                                                 std::min<double>(args.cpu_min, max_cpu_limit), max_cpu_limit);
+        long long const next_quota_us = std::max<long long>(
+                static_cast<long long>(next_cpu_limit / 100 * period_us * cpus_count), MIN_CPU_QUOTA_US);
+        if (next_quota_us != quota_us) {
+            writes.push_back({cont.cpu_dir, "cpu.cfs_quota_us", std::to_string(next_quota_us), quota});
+            fields << ",\"cpu_limit\":" << next_cpu_limit;
+            record_cpu_limit = std::max(1, static_cast<int>(next_cpu_limit + 0.5));
+        }
+    }
+
+    if (args.memory_max) {
+        std::string const limit = read_cgroup_value(cont.memory_dir, "memory.limit_in_bytes");
+        double const usage = std::stoull(read_cgroup_value(cont.memory_dir, "memory.usage_in_bytes"));
+        double const memory_limit = std::min<double>(std::stoull(limit), args.memory_max);
+        unsigned long long const next_memory_limit = static_cast<unsigned long long>(
+                next_limit(memory_limit, usage, memory_pct, args.memory_target, args.step_percent,
+                           args.memory_min, args.memory_max));
+        static unsigned long long const PAGE_SIZE = 4096; // kernel rounds limit down to pages
+        if (next_memory_limit / PAGE_SIZE != std::stoull(limit) / PAGE_SIZE) {
+            writes.push_back({cont.memory_dir, "memory.limit_in_bytes", std::to_string(next_memory_limit), limit});
+            fields << ",\"memory_limit\":" << next_memory_limit;
+            record_memory_limit = next_memory_limit;
+        }
+    }
+
+    if (args.debug_enabled) {
+        printDebug() << cont.record.pid << ": cpu usage " << cpu_usage << "%, cpu pressure " << cpu_pct
+                     << "%, memory pressure " << memory_pct << '%' << std::endl;
+    }
+    if (writes.empty()) {
+        return;
+    }
+    apply_cgroup_writes(writes, args.debug_enabled);
+    // Charges failed because of our own limit change aren't container's pressure
+    cont.last.memory_failcnt = std::stoull(read_cgroup_value(cont.memory_dir, "memory.failcnt"));
+    // Only changed limits are written: aucont update may have changed the others meanwhile
+    container_registry().update_limits(cont.record, record_cpu_limit, record_memory_limit);
+    publish_event("update", cont.record, fields.str());
+    std::cout << "Container " << cont.record.pid << " limits updated: " << fields.str() << std::endl;
+}
+
+// Containers are controlled only if they are in daemon slice (any if it is
+// empty), new ones are only sampled in their first interval
+static void sync_containers(std::map<int, controlled_container> &controlled, daemon_arguments const &args) {
+    std::map<int, controlled_container> synced;
+    std::string const slice_prefix = args.slice.empty() ? "/" : "/" + args.slice + "/";
+    for (container_record const &record: container_registry().records()) {
+        if (std::string(record.cgroup).compare(0, slice_prefix.size(), slice_prefix) != 0 ||
+                !process_alive(record.pid, record.proc_start_time)) {
+            continue;
+        }
+        auto const found = controlled.find(record.pid);
+        if (found != controlled.end() && strcmp(found->second.record.id, record.id) == 0) {
+            synced[record.pid] = found->second;
+            continue;
+        }
+        try {
+            controlled_container cont;
+            cont.record = record;
+            cont.cpu_dir = container_cgroup_dir(CPU_CGROUP_DIR, record.pid);
+            cont.cpuacct_dir = container_cgroup_dir(CPUACCT_CGROUP_DIR, record.pid);
+            cont.memory_dir = container_cgroup_dir(MEMORY_CGROUP_DIR, record.pid);
+            cont.last = read_pressure(cont);
+            cont.last_time = daemon_clock::now();
+            cont.idle_sec = 0;
+            cont.reclaim_exhausted = false;
+            std::ifstream(saved_soft_limit_file(cont)) >> cont.busy_soft_limit; // saved by killed daemon
+            restore_soft_limit(cont, args);
+            synced[record.pid] = cont;
+            if (args.debug_enabled) {
+                printDebug() << "Controlling container " << record.pid << (cont.last.cpu_psi ? " (cpu PSI" :
+                                " (cpu throttling") << (cont.last.memory_psi ? ", memory PSI)" : ", memory failcnt)")
+                             << std::endl;
+            }
+        } catch(std::exception &e) { // exited meanwhile
+            if (args.debug_enabled) {
+                printDebug() << e.what() << std::endl;
+            }
+        }
+    }
+    controlled.swap(synced);
+}
+
+static void stop_daemon(int) {
+    daemon_stopping = 1;
+}
+
+int aucont_daemon(daemon_arguments const &args) {
+    struct sigaction stop_action = {};
+    stop_action.sa_handler = stop_daemon; // no SA_RESTART: sleep is interrupted
+    sigaction(SIGINT, &stop_action, nullptr);
+    sigaction(SIGTERM, &stop_action, nullptr);
+    try {
+        long const cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
+        if (args.debug_enabled) {
+            printDebug() << "Cpu pressure target " << args.cpu_target << "%, limit " << args.cpu_min << ".."
+                         << args.cpu_max << '%' << std::endl;
+            if (args.memory_max) {
+                printDebug() << "Memory pressure target " << args.memory_target << "%, limit " << args.memory_min
+                             << ".." << args.memory_max << std::endl;
+            }
+        }
+        std::map<int, controlled_container> controlled;
+        while (!daemon_stopping) {
+            sync_containers(controlled, args);
+            usleep(args.interval_ms * 1000);
+            if (daemon_stopping) {
+                break;
+            }
+            for (auto &entry: controlled) {
+                try {
+                    control_container(entry.second, args, cpus_count);
+                } catch(std::exception &e) {
+                    container_record const &record = entry.second.record;
+                    if (process_alive(record.pid, record.proc_start_time)) {
+                        std::cerr << "Failed to control container " << record.pid << ": " << e.what() << std::endl;
+                    } // exited container is dropped by next sync
+                }
+            }
+        }
+        for (auto &entry: controlled) { // idle containers get their soft limits back
+            try {
+                restore_soft_limit(entry.second, args);
+            } catch(std::exception &e) {
+                if (args.debug_enabled) {
+                    printDebug() << e.what() << std::endl;
+                }
+            }
+        }
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
@@ -0,0 +1,513 @@
+#include "aucont.h"
+#include "cgroups.h"
+#include "error_codes.h"
+#include "events.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <wait.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+
+std::string const EVENTS_FILE_NAME = "/tmp/aucont/events";
+
+static off_t const EVENTS_FILE_MAX_SIZE = 4 << 20; // then it is renamed to EVENTS_FILE_NAME.1
+static int const EXIT_STATUS_WAIT_MS = 200; // for start process to publish exit status
+static int const LATE_EXIT_KEEP_MS = 60 * 1000; // exit with status published later is dropped till then
+static int const MAX_EVENTS = 64;
+static size_t const READ_CHUNK = 1 << 16;
+
+typedef std::chrono::steady_clock events_clock;
+
+static std::string event_line(std::string const &type, container_record const &record, std::string const &fields) {
+    long long const time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    std::ostringstream line;
+    line << "{\"time\":" << time_ms << ",\"type\":\"" << type << "\",\"id\":\"" << json_escape(record.id)
+         << "\",\"name\":\"" << json_escape(record.name) << "\",\"pid\":" << record.pid
+         << (fields.empty() ? "" : ",") << fields << "}\n";
+    return line.str();
+}
+
+void publish_event(std::string const &type, container_record const &record, std::string const &fields) {
+    std::string const line = event_line(type, record, fields);
+    mkdir(EVENTS_FILE_NAME.substr(0, EVENTS_FILE_NAME.rfind('/')).c_str(), 0777);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        int const fd = open(EVENTS_FILE_NAME.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+        if (fd == -1) {
+            return;
+        }
+        // Lock serializes rotation with appends. File rotated while we were
+        // waiting for the lock is reopened
+        flock(fd, LOCK_EX);
+        struct stat fd_stat, path_stat;
+        bool const rotated = fstat(fd, &fd_stat) == -1 || stat(EVENTS_FILE_NAME.c_str(), &path_stat) == -1 ||
+                fd_stat.st_ino != path_stat.st_ino;
+        if (!rotated) {
+            if (fd_stat.st_size > EVENTS_FILE_MAX_SIZE) { // readers finish old file by its fd
+                rename(EVENTS_FILE_NAME.c_str(), (EVENTS_FILE_NAME + ".1").c_str());
+            }
+            ssize_t const written = write(fd, line.data(), line.size());
+            (void) written;
+        }
+        close(fd);
+        if (!rotated) {
+            return;
+        }
+    }
+}
+
+std::string exit_status_fields(int status) {
+    if (WIFEXITED(status)) {
+        return "\"status\":" + std::to_string(WEXITSTATUS(status));
+    }
+    if (WIFSIGNALED(status)) {
+        return "\"status\":null,\"signal\":" + std::to_string(WTERMSIG(status));
+    }
+    return "\"status\":null";
+}
+
+// Value of envelope field of line written by event_line
+static std::string event_field(std::string const &line, std::string const &key) {
+    std::string const prefix = "\"" + key + "\":";
+    size_t pos = line.find(prefix);
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += prefix.size();
+    if (line[pos] == '"') {
+        return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+    }
+    return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+struct cpu_stat {
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+    uint64_t throttled_ns;
+};
+
+static cpu_stat read_cpu_stat(std::string const &cpu_dir) {
+    cpu_stat stat = {};
+    std::ifstream stat_file(cpu_dir + "/cpu.stat");
+    std::string key;
+    uint64_t value;
+    while (stat_file >> key >> value) {
+        if (key == "nr_periods") {
+            stat.nr_periods = value;
+        } else if (key == "nr_throttled") {
+            stat.nr_throttled = value;
+        } else if (key == "throttled_time") {
+            stat.throttled_ns = value;
+        }
+    }
+    return stat;
+}
+
+// Registers eventfd for memory.oom_control of cgroup v1 memory dir,
+// cgroup.event_control is writable by everyone. Returns -1 on failure.
+static int oom_eventfd(std::string const &memory_dir) {
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int const control_fd = open((memory_dir + "/memory.oom_control").c_str(), O_RDONLY | O_CLOEXEC);
+    int const event_control_fd = open((memory_dir + "/cgroup.event_control").c_str(), O_WRONLY | O_CLOEXEC);
+    bool registered = false;
+    if (event_fd != -1 && control_fd != -1 && event_control_fd != -1) {
+        std::string const request = std::to_string(event_fd) + " " + std::to_string(control_fd);
+        registered = write(event_control_fd, request.data(), request.size()) == static_cast<ssize_t>(request.size());
+    }
+    for (int fd: {control_fd, event_control_fd}) { // kernel doesn't need them after registration
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    if (!registered && event_fd != -1) {
+        close(event_fd);
+        event_fd = -1;
+    }
+    return event_fd;
+}
+
+// Follows events file and watches running containers: exit through pidfd,
+// OOM through memory cgroup eventfd and throttling by polling cpu.stat,
+// cgroup v1 doesn't notify about its changes.
+class event_watcher {
+public:
+    explicit event_watcher(events_arguments const &args);
+    ~event_watcher();
+
+    void run();
+
+private:
+    enum source_t : uint32_t {
+        SOURCE_LOG,
+        SOURCE_TIMER,
+        SOURCE_EXIT,
+        SOURCE_OOM
+    };
+
+    struct container {
+        container_record record;
+        int pidfd; // -1: pidfd isn't supported, liveness is polled
+        int oom_fd; // -1: no OOM notification
+        std::string cpu_dir;
+        std::string memory_dir;
+        cpu_stat last_stat;
+        bool exited;
+        events_clock::time_point exit_deadline; // exit without status is printed after it
+    };
+
+    void add_to_epoll(int fd, source_t source, int pid);
+    void close_fd(int &fd);
+    void watch(container_record const &record);
+    void unwatch(int pid);
+    void mark_exited(container &cont);
+    void open_log();
+    void read_log();
+    void handle_log_line(std::string const &line);
+    void handle_oom(container &cont);
+    void poll_containers();
+    int next_timeout_ms();
+    void print(std::string const &line);
+
+private:
+    events_arguments const args;
+    int epoll_fd;
+    int inotify_fd;
+    int timer_fd;
+    int log_fd;
+    ino_t log_inode;
+    std::string partial_line;
+    std::map<int, container> containers;
+    // Exits printed without status by id and pid, till they expire
+    std::map<std::pair<std::string, int>, events_clock::time_point> statusless_exits;
+};
+
+event_watcher::event_watcher(events_arguments const &args):
+    args(args),
+    epoll_fd(check_result(epoll_create1(EPOLL_CLOEXEC), "Failed to create epoll")),
+    inotify_fd(-1),
+    timer_fd(-1),
+    log_fd(-1),
+    log_inode(0)
+{
+    try {
+        std::string const dir = EVENTS_FILE_NAME.substr(0, EVENTS_FILE_NAME.rfind('/'));
+        mkdir(dir.c_str(), 0777);
+        // Directory is watched: events file is replaced by rotation
+        inotify_fd = check_result(inotify_init1(IN_NONBLOCK | IN_CLOEXEC), "Failed to init inotify");
+        check_result(inotify_add_watch(inotify_fd, dir.c_str(), IN_MODIFY | IN_CREATE | IN_MOVED_TO),
+                     "Failed to watch " + dir);
+        add_to_epoll(inotify_fd, SOURCE_LOG, 0);
+        open_log();
+        check_result(lseek(log_fd, 0, SEEK_END), "Failed to seek events file"); // only new events
+
+        timer_fd = check_result(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "Failed to create timer");
+        itimerspec interval = {};
+        interval.it_interval.tv_sec = args.throttle_interval_ms / 1000;
+        interval.it_interval.tv_nsec = args.throttle_interval_ms % 1000 * 1000000L;
+        interval.it_value = interval.it_interval;
+        check_result(timerfd_settime(timer_fd, 0, &interval, nullptr), "Failed to set timer");
+        add_to_epoll(timer_fd, SOURCE_TIMER, 0);
+
+        for (container_record const &record: container_registry().records()) {
+            if (process_alive(record.pid, record.proc_start_time)) {
+                watch(record);
+            }
+        }
+    } catch(...) {
+        for (auto &cont: containers) {
+            close_fd(cont.second.pidfd);
+            close_fd(cont.second.oom_fd);
+        }
+        close_fd(log_fd);
+        close_fd(timer_fd);
+        close_fd(inotify_fd);
+        close(epoll_fd);
+        throw;
+    }
+}
+
+event_watcher::~event_watcher() {
+    while (!containers.empty()) {
+        unwatch(containers.begin()->first);
+    }
+    close_fd(log_fd);
+    close_fd(timer_fd);
+    close_fd(inotify_fd);
+    close(epoll_fd);
+}
+
+void event_watcher::add_to_epoll(int fd, source_t source, int pid) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = static_cast<uint64_t>(source) << 32 | static_cast<uint32_t>(pid);
+    check_result(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event), "Failed to add fd to epoll");
+}
+
+// closing fds removes them from epoll
+void event_watcher::close_fd(int &fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void event_watcher::watch(container_record const &record) {
+    if (containers.count(record.pid)) {
+        return;
+    }
+    container &cont = containers[record.pid];
+    cont.record = record;
+    cont.pidfd = -1;
+    cont.oom_fd = -1;
+    cont.last_stat = {};
+    cont.exited = false;
+#ifdef SYS_pidfd_open
+    cont.pidfd = syscall(SYS_pidfd_open, record.pid, 0);
+#endif
+    if (!process_alive(record.pid, record.proc_start_time)) { // exited before we have looked
+        close_fd(cont.pidfd);
+        mark_exited(cont);
+        return;
+    }
+    if (cont.pidfd != -1) {
+        add_to_epoll(cont.pidfd, SOURCE_EXIT, record.pid);
+    } else if (args.debug_enabled) {
+        printDebug() << "pidfd is not supported, polling container " << record.pid << std::endl;
+    }
+
+    try {
+        cont.cpu_dir = container_cgroup_dir(CPU_CGROUP_DIR, record.pid);
+        cont.last_stat = read_cpu_stat(cont.cpu_dir);
+        cont.memory_dir = container_cgroup_dir(MEMORY_CGROUP_DIR, record.pid);
+        cont.oom_fd = oom_eventfd(cont.memory_dir);
+    } catch(aucont_exception &e) {
+        if (args.debug_enabled) {
+            printDebug() << e.what() << std::endl;
+        }
+    }
+    if (cont.oom_fd != -1) {
+        add_to_epoll(cont.oom_fd, SOURCE_OOM, record.pid);
+    } else if (args.debug_enabled) {
+        printDebug() << "No OOM notifications for container " << record.pid << std::endl;
+    }
+}
+
+void event_watcher::unwatch(int pid) {
+    auto const found = containers.find(pid);
+    if (found != containers.end()) {
+        close_fd(found->second.pidfd);
+        close_fd(found->second.oom_fd);
+        containers.erase(found);
+    }
+}
+
+// Start process of not daemonized container publishes exit with status,
+// exit is printed without it if nobody has done that in time. Status
+// published after that is dropped, so there is one exit per container.
+void event_watcher::mark_exited(container &cont) {
+    close_fd(cont.pidfd);
+    if (cont.oom_fd != -1) { // OOM kill may come in the same epoll batch after exit
+        handle_oom(cont);
+        close_fd(cont.oom_fd);
+    }
+    cont.exited = true;
+    cont.exit_deadline = events_clock::now() + std::chrono::milliseconds(EXIT_STATUS_WAIT_MS);
+}
+
+void event_watcher::open_log() {
+    log_fd = check_result(open(EVENTS_FILE_NAME.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0666),
+                          "Failed to open " + EVENTS_FILE_NAME);
+    struct stat log_stat;
+    check_result(fstat(log_fd, &log_stat), "Failed to stat " + EVENTS_FILE_NAME);
+    log_inode = log_stat.st_ino;
+}
+
+// Reads appended lines, rotated file is read till the end before the new one
+void event_watcher::read_log() {
+    char buffer[READ_CHUNK];
+    while (true) {
+        ssize_t const was_read = read(log_fd, buffer, sizeof(buffer));
+        if (was_read == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(was_read, "Failed to read " + EVENTS_FILE_NAME);
+        if (was_read > 0) {
+            partial_line.append(buffer, was_read);
+            size_t line_end;
+            while ((line_end = partial_line.find('\n')) != std::string::npos) {
+                handle_log_line(partial_line.substr(0, line_end));
+                partial_line.erase(0, line_end + 1);
+            }
+            continue;
+        }
+
+        struct stat path_stat;
+        if (stat(EVENTS_FILE_NAME.c_str(), &path_stat) == -1 || path_stat.st_ino == log_inode) {
+            return;
+        }
+        close_fd(log_fd);
+        partial_line.clear();
+        open_log();
+    }
+}
+
+void event_watcher::handle_log_line(std::string const &line) {
+    std::string const type = event_field(line, "type");
+    int const pid = strtol(event_field(line, "pid").c_str(), nullptr, 10);
+    if (type == "exit" && statusless_exits.erase(std::make_pair(event_field(line, "id"), pid))) {
+        return; // too late, printed without status
+    }
+    print(line + "\n");
+    if (type == "start") {
+        container_record record;
+        if (container_registry().find_by_pid(pid, record)) {
+            watch(record);
+        }
+    } else if (type == "exit") { // published with status
+        unwatch(pid);
+    }
+}
+
+void event_watcher::handle_oom(container &cont) {
+    uint64_t count;
+    if (read(cont.oom_fd, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+    std::string fields;
+    std::ifstream oom_control(cont.memory_dir + "/memory.oom_control");
+    std::string key;
+    uint64_t value;
+    while (oom_control >> key >> value) { // oom_kill appeared in linux 4.13
+        fields += (fields.empty() ? "\"" : ",\"") + key + "\":" + std::to_string(value);
+    }
+    print(event_line("oom", cont.record, fields));
+}
+
+void event_watcher::poll_containers() {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+    for (auto &entry: containers) {
+        container &cont = entry.second;
+        if (cont.exited) {
+            continue;
+        }
+        if (cont.pidfd == -1 && !process_alive(cont.record.pid, cont.record.proc_start_time)) {
+            mark_exited(cont);
+            continue;
+        }
+        if (cont.cpu_dir.empty()) {
+            continue;
+        }
+        cpu_stat const stat = read_cpu_stat(cont.cpu_dir);
+        if (stat.nr_throttled > cont.last_stat.nr_throttled) {
+            std::ostringstream fields;
+            fields << "\"nr_periods\":" << stat.nr_periods - cont.last_stat.nr_periods
+                   << ",\"nr_throttled\":" << stat.nr_throttled - cont.last_stat.nr_throttled
+                   << ",\"throttled_us\":" << (stat.throttled_ns - cont.last_stat.throttled_ns) / 1000;
+            print(event_line("throttle", cont.record, fields.str()));
+        }
+        cont.last_stat = stat;
+    }
+}
+
+// Till the nearest exit waiting for status, -1 if there are none
+int event_watcher::next_timeout_ms() {
+    int timeout = -1;
+    auto const now = events_clock::now();
+    for (auto exit_it = statusless_exits.begin(); exit_it != statusless_exits.end();) {
+        if (exit_it->second <= now) {
+            exit_it = statusless_exits.erase(exit_it);
+        } else {
+            ++exit_it;
+        }
+    }
+    for (auto entry_it = containers.begin(); entry_it != containers.end();) {
+        container const &cont = entry_it->second;
+        ++entry_it;
+        if (!cont.exited) {
+            continue;
+        }
+        if (cont.exit_deadline <= now) {
+            print(event_line("exit", cont.record, "\"status\":null"));
+            statusless_exits[std::make_pair(std::string(cont.record.id), cont.record.pid)] =
+                    now + std::chrono::milliseconds(LATE_EXIT_KEEP_MS);
+            unwatch(cont.record.pid);
+            continue;
+        }
+        int const left = std::chrono::duration_cast<std::chrono::milliseconds>(cont.exit_deadline - now).count() + 1;
+        timeout = timeout == -1 ? left : std::min(timeout, left);
+    }
+    return timeout;
+}
+
+void event_watcher::print(std::string const &line) {
+    std::cout << line << std::flush;
+}
+
+void event_watcher::run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int const ready = epoll_wait(epoll_fd, events, MAX_EVENTS, next_timeout_ms());
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(ready, "epoll_wait failed");
+        for (int event_idx = 0; event_idx < ready; ++event_idx) {
+            source_t const source = static_cast<source_t>(events[event_idx].data.u64 >> 32);
+            int const pid = static_cast<int>(events[event_idx].data.u64 & 0xffffffff);
+            auto const found = containers.find(pid);
+            switch (source) {
+            case SOURCE_LOG: {
+                char buffer[READ_CHUNK]; // inotify events only wake us up
+                while (read(inotify_fd, buffer, sizeof(buffer)) > 0) {
+                }
+                read_log();
+                break;
+            }
+            case SOURCE_TIMER:
+                poll_containers();
+                break;
+            case SOURCE_EXIT: // container may be unwatched by previous event of the batch
+                if (found != containers.end() && !found->second.exited) {
+                    mark_exited(found->second);
+                }
+                break;
+            case SOURCE_OOM:
+                if (found != containers.end() && !found->second.exited) {
+                    handle_oom(found->second);
+                }
+                break;
+            }
+        }
+    }
+}
+
+int aucont_events(events_arguments const &args) {
+    try {
+        if (args.debug_enabled) {
+            printDebug() << "Following " << EVENTS_FILE_NAME << ", cpu.stat is polled every "
+                         << args.throttle_interval_ms << "ms" << std::endl;
+        }
+        event_watcher watcher(args);
+        watcher.run();
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
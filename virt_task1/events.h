@@ -0,0 +1,19 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+#include "registry.h"
+#include <string>
+
+// Commands append events they cause (start, stop, update, ...) as JSON lines
+// to EVENTS_FILE_NAME. aucont events follows the file and adds exit, oom and
+// throttle events it watches for itself.
+extern std::string const EVENTS_FILE_NAME;
+
+// Appends {"time":MS,"type":TYPE,"id":..,"name":..,"pid":..,FIELDS} line,
+// fields is JSON object body without braces. Failures are ignored: events
+// are best effort and must not fail the command which publishes them.
+void publish_event(std::string const &type, container_record const &record, std::string const &fields = "");
+
+// JSON fields of waitpid status: exit code or terminating signal
+std::string exit_status_fields(int status);
+
+#endif // EVENTS_H
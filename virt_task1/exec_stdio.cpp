@@ -0,0 +1,346 @@
+#include "exec_stdio.h"
+#include "utils.h"
+#include <iostream>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+
+
+static size_t const SPLICE_CHUNK = 1 << 16; // 64kb, default pipe capacity
+static int const MAX_EVENTS = 16;
+
+exec_stdio::exec_stdio(bool tty, bool interactive, bool debug_enabled):
+    tty(tty),
+    interactive(interactive),
+    debug_enabled(debug_enabled),
+    pty_master(-1),
+    command_fds{-1, -1, -1},
+    epoll_fd(-1),
+    winch_fd(-1),
+    terminal_raw(false)
+{
+    try {
+        if (tty) {
+            pty_master = check_result(posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC), "Failed to open pty master");
+            check_result(grantpt(pty_master), "Failed to grant pty");
+            check_result(unlockpt(pty_master), "Failed to unlock pty");
+            char const *slave_name = ptsname(pty_master);
+            check_result(slave_name != nullptr, "Failed to get pty name", [](int ok) { return ok != 0; });
+            int const slave = check_result(open(slave_name, O_RDWR | O_NOCTTY | O_CLOEXEC),
+                                           std::string("Failed to open ") + slave_name);
+            std::fill(command_fds, command_fds + 3, slave);
+            if (interactive) { // separate fd for input direction, so it has its own epoll registration
+                our_ends.push_back(check_result(fcntl(pty_master, F_DUPFD_CLOEXEC, 0), "Failed to dup pty master"));
+            }
+            resize_pty();
+            if (debug_enabled) {
+                printDebug() << "Command terminal is " << slave_name << std::endl;
+            }
+        } else if (interactive) {
+            for (int fd = 0; fd < 3; ++fd) {
+                int pipe_fds[2];
+                check_result(pipe2(pipe_fds, O_CLOEXEC), "Failed to create stdio pipe");
+                command_fds[fd] = pipe_fds[fd == STDIN_FILENO ? 0 : 1];
+                our_ends.push_back(pipe_fds[fd == STDIN_FILENO ? 1 : 0]);
+            }
+        }
+    } catch(...) {
+        close_fds();
+        throw;
+    }
+}
+
+exec_stdio::~exec_stdio() {
+    close_fds();
+}
+
+void exec_stdio::close_fds() {
+    if (terminal_raw) {
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &saved_terminal);
+        terminal_raw = false;
+    }
+    if (winch_fd != -1) {
+        sigset_t winch;
+        sigemptyset(&winch);
+        sigaddset(&winch, SIGWINCH);
+        sigprocmask(SIG_UNBLOCK, &winch, nullptr);
+        close(winch_fd);
+        winch_fd = -1;
+    }
+    for (int fd = 0; fd < 3; ++fd) {
+        if (command_fds[fd] != -1 && std::find(command_fds, command_fds + fd, command_fds[fd]) == command_fds + fd) {
+            close(command_fds[fd]); // pty slave is used for all three
+        }
+    }
+    std::fill(command_fds, command_fds + 3, -1);
+    for (direction &dir: directions) {
+        for (int fd: dir.pipe_fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+    directions.clear();
+    for (int fd: our_ends) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    our_ends.clear();
+    if (pty_master != -1) {
+        close(pty_master);
+        pty_master = -1;
+    }
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+void exec_stdio::setup_command() {
+    if (!tty && !interactive) {
+        return;
+    }
+    if (tty) {
+        check_result(setsid(), "Failed to create new session");
+        check_result(ioctl(command_fds[0], TIOCSCTTY, 0), "Failed to set controlling terminal");
+    }
+    for (int fd = 0; fd < 3; ++fd) {
+        check_result(dup2(command_fds[fd], fd), "Failed to redirect command stdio");
+    }
+}
+
+void exec_stdio::resize_pty() {
+    winsize size;
+    if (pty_master != -1 &&
+            (ioctl(STDIN_FILENO, TIOCGWINSZ, &size) == 0 || ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)) {
+        ioctl(pty_master, TIOCSWINSZ, &size);
+    }
+}
+
+void exec_stdio::set_polled(direction &dir, bool polled) {
+    if (dir.polled == polled) {
+        return;
+    }
+    epoll_event event = {};
+    event.events = polled ? EPOLLIN : 0;
+    event.data.fd = dir.from;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, dir.from, &event);
+    dir.polled = polled;
+}
+
+// Command side fds are non-blocking and edge triggered, ours are left as is:
+// they are shared with our parent. Our stdin is level triggered and read once
+// per readiness, blocking writes to our stdout just slow the command down.
+void exec_stdio::add_direction(int from, int to, int owned_fd, bool output) {
+    direction dir = {from, to, {-1, -1}, 0, owned_fd, false, false, false, false, false, output, false};
+    check_result(pipe2(dir.pipe_fds, O_CLOEXEC | O_NONBLOCK), "Failed to create relay pipe");
+    directions.push_back(dir);
+
+    bool const from_ours = from == STDIN_FILENO;
+    epoll_event event = {};
+    event.events = from_ours ? EPOLLIN : EPOLLIN | EPOLLET;
+    event.data.fd = from;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, from, &event) == 0) {
+        directions.back().wait_ready = from_ours;
+        directions.back().polled = from_ours;
+    } else { // regular file or /dev/null: always readable
+        check_result(errno == EPERM ? 0 : -1, "Failed to add stdio fd to epoll");
+    }
+    event.events = EPOLLOUT | EPOLLET;
+    event.data.fd = to;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, to, &event) == -1) {
+        check_result(errno == EPERM ? 0 : -1, "Failed to add stdio fd to epoll");
+    }
+}
+
+// Copies when 'from' can't splice. Relay pipe is empty and holds SPLICE_CHUNK.
+static ssize_t copy_to_pipe(int from, int pipe_in) {
+    char buffer[SPLICE_CHUNK];
+    ssize_t const got = read(from, buffer, sizeof(buffer));
+    return got > 0 ? write(pipe_in, buffer, got) : got;
+}
+
+// Copies when 'to' can't splice, it is one of our fds: it is written until
+// everything read from relay pipe is written
+static ssize_t copy_from_pipe(int pipe_out, int to, size_t size) {
+    char buffer[SPLICE_CHUNK];
+    ssize_t const got = read(pipe_out, buffer, std::min(size, sizeof(buffer)));
+    for (ssize_t written = 0; written < got;) {
+        ssize_t const result = write(to, buffer + written, got - written);
+        if (result == -1 && errno == EAGAIN) {
+            pollfd writable = {to, POLLOUT, 0};
+            poll(&writable, 1, -1);
+        } else if (result == -1 && errno != EINTR) {
+            return -1;
+        } else if (result > 0) {
+            written += result;
+        }
+    }
+    return got;
+}
+
+void exec_stdio::pump(direction &dir) {
+    while (!dir.done) {
+        if (dir.in_pipe != 0) {
+            ssize_t const moved = dir.copy_to ? copy_from_pipe(dir.pipe_fds[0], dir.to, dir.in_pipe) :
+                                                splice(dir.pipe_fds[0], nullptr, dir.to, nullptr, dir.in_pipe,
+                                                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved == -1 && errno == EINVAL && !dir.copy_to) {
+                if (debug_enabled) {
+                    printDebug() << "fd " << dir.to << " doesn't support splice, it is written" << std::endl;
+                }
+                dir.copy_to = true;
+                continue;
+            }
+            if (moved == -1 && errno == EINTR) {
+                continue;
+            }
+            if (moved == -1 && errno == EAGAIN) {
+                break; // wait for EPOLLOUT on 'to'
+            }
+            if (moved == -1) { // reader is gone, closing 'from' passes it on
+                finish(dir);
+                return;
+            }
+            dir.in_pipe -= moved;
+            continue;
+        }
+        if (dir.wait_ready && !dir.ready) {
+            break;
+        }
+        ssize_t const moved = dir.copy_from ? copy_to_pipe(dir.from, dir.pipe_fds[1]) :
+                                              splice(dir.from, nullptr, dir.pipe_fds[1], nullptr, SPLICE_CHUNK,
+                                                     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved == -1 && errno == EINVAL && !dir.copy_from) {
+            if (debug_enabled) {
+                printDebug() << "fd " << dir.from << " doesn't support splice, it is read" << std::endl;
+            }
+            dir.copy_from = true;
+            continue;
+        }
+        if (moved == -1 && errno == EINTR) {
+            continue;
+        }
+        dir.ready = false;
+        if (moved == -1 && errno == EAGAIN) {
+            break; // wait for EPOLLIN on 'from'
+        }
+        if (moved == 0 || (moved == -1 && errno == EIO)) { // EIO: pty slave is closed
+            dir.in_pipe = 0;
+            finish(dir);
+            return;
+        }
+        check_result(moved, "Failed to relay command stdio");
+        dir.in_pipe += moved;
+    }
+    if (dir.wait_ready && !dir.done) { // level triggered 'from' would spin while 'to' is full
+        set_polled(dir, dir.in_pipe == 0);
+    }
+}
+
+// Closing command side fd passes EOF to command stdin or SIGPIPE to its output
+void exec_stdio::finish(direction &dir) {
+    dir.done = true;
+    if (dir.owned_fd != -1) {
+        close(dir.owned_fd); // removes it from epoll
+        std::replace(our_ends.begin(), our_ends.end(), dir.owned_fd, -1);
+        if (dir.owned_fd == pty_master) {
+            pty_master = -1;
+        }
+        dir.owned_fd = -1;
+    }
+    if (dir.polled) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, dir.from, nullptr);
+        dir.polled = false;
+    }
+}
+
+void exec_stdio::relay() {
+    if (!tty && !interactive) {
+        return;
+    }
+    signal(SIGPIPE, SIG_IGN); // closed readers are handled by EPIPE
+    for (int fd = 0; fd < 3; ++fd) {
+        if (command_fds[fd] != -1 && std::find(command_fds, command_fds + fd, command_fds[fd]) == command_fds + fd) {
+            close(command_fds[fd]);
+        }
+    }
+    std::fill(command_fds, command_fds + 3, -1);
+    for (int fd: our_ends) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    if (pty_master != -1) {
+        fcntl(pty_master, F_SETFL, fcntl(pty_master, F_GETFL) | O_NONBLOCK);
+    }
+
+    epoll_fd = check_result(epoll_create1(EPOLL_CLOEXEC), "Failed to create epoll");
+    directions.reserve(3);
+    if (tty) {
+        if (interactive) {
+            add_direction(STDIN_FILENO, our_ends[0], our_ends[0], false);
+        }
+        add_direction(pty_master, STDOUT_FILENO, pty_master, true);
+
+        sigset_t winch;
+        sigemptyset(&winch);
+        sigaddset(&winch, SIGWINCH);
+        check_result(sigprocmask(SIG_BLOCK, &winch, nullptr), "Failed to block SIGWINCH");
+        winch_fd = check_result(signalfd(-1, &winch, SFD_CLOEXEC | SFD_NONBLOCK), "Failed to create signalfd");
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = winch_fd;
+        check_result(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, winch_fd, &event), "Failed to add signalfd to epoll");
+
+        if (interactive && isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_terminal) == 0) {
+            termios raw = saved_terminal; // keys like ^C go to command terminal
+            cfmakeraw(&raw);
+            terminal_raw = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+        }
+    } else {
+        add_direction(STDIN_FILENO, our_ends[0], our_ends[0], false);
+        add_direction(our_ends[1], STDOUT_FILENO, our_ends[1], true);
+        add_direction(our_ends[2], STDERR_FILENO, our_ends[2], true);
+    }
+    std::cout.flush();
+
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        bool outputs_done = true;
+        for (direction &dir: directions) {
+            pump(dir);
+            outputs_done = outputs_done && (!dir.output || dir.done);
+        }
+        if (outputs_done) {
+            break;
+        }
+        int const ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(ready, "epoll_wait failed");
+        for (int event_idx = 0; event_idx < ready; ++event_idx) {
+            int const fd = events[event_idx].data.fd;
+            if (fd == winch_fd) {
+                signalfd_siginfo info;
+                while (read(winch_fd, &info, sizeof(info)) == sizeof(info)) {
+                }
+                resize_pty();
+                continue;
+            }
+            for (direction &dir: directions) {
+                if (dir.from == fd && dir.wait_ready) {
+                    dir.ready = true;
+                }
+            }
+        }
+    }
+    close_fds();
+}
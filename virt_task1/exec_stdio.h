@@ -0,0 +1,67 @@
+#ifndef EXEC_STDIO_H
+#define EXEC_STDIO_H
+#include <stddef.h>
+#include <termios.h>
+#include <vector>
+
+// Stdio of command run by aucont exec. By default command inherits our fds.
+// With interactive it gets pipes, with tty a pseudo terminal (stdout and
+// stderr are merged then), and relay() moves bytes between them and our fds
+// like port forwarder does: with splice() through a pipe per direction.
+// Our stdin is forwarded only if interactive.
+class exec_stdio {
+public:
+    // Allocates pipes or pty, must be called before container ns are entered
+    exec_stdio(bool tty, bool interactive, bool debug_enabled);
+    // Closes fds and restores our terminal mode
+    ~exec_stdio();
+
+    // Called in forked command process before exec
+    void setup_command();
+
+    // Closes command ends and relays stdio until command outputs are
+    // closed, i.e. command and its children holding them exited
+    void relay();
+
+private:
+    // from -> pipe -> to
+    struct direction {
+        int from;
+        int to;
+        int pipe_fds[2];
+        size_t in_pipe;
+        int owned_fd; // command side fd closed when direction is done, -1 - none
+        bool wait_ready; // 'from' is our blocking fd: one transfer per readiness
+        bool ready;
+        bool polled; // 'from' is in epoll, it is removed while 'to' is full
+        bool copy_from; // 'from' can't splice (tty before linux 6.5), it is read instead
+        bool copy_to; // 'to' can't splice (O_APPEND file), it is written instead
+        bool output; // relay ends when all outputs are done
+        bool done;
+    };
+
+    exec_stdio(exec_stdio const &) = delete;
+    exec_stdio& operator=(exec_stdio const &) = delete;
+
+    void add_direction(int from, int to, int owned_fd, bool output);
+    void pump(direction &dir);
+    void finish(direction &dir);
+    void set_polled(direction &dir, bool polled);
+    void resize_pty();
+    void close_fds();
+
+private:
+    bool tty;
+    bool interactive;
+    bool debug_enabled;
+    int pty_master;
+    int command_fds[3]; // command stdin, stdout, stderr
+    std::vector<int> our_ends; // command pipes ends and pty master dup kept by us
+    std::vector<direction> directions;
+    int epoll_fd;
+    int winch_fd; // signalfd of SIGWINCH, terminal size is passed to pty
+    bool terminal_raw;
+    termios saved_terminal;
+};
+
+#endif // EXEC_STDIO_H
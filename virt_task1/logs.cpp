@@ -0,0 +1,367 @@
+#include "aucont.h"
+#include "error_codes.h"
+#include "logs.h"
+#include "registry.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+
+std::string const LOGS_DIR = "/tmp/aucont/logs";
+int const MAX_EXITED_LOGS = 64;
+
+static std::string const LOG_FILE = "container.log";
+static std::string const COLLECTOR_FILE = ".collector"; // collector pid, removed when it finishes
+static int const RING_SIZE = 1 << 20; // F_SETPIPE_SZ is capped by fs.pipe-max-size (1MB by default)
+static size_t const SPLICE_CHUNK = 1 << 20;
+static size_t const COPY_CHUNK = 1 << 16;
+static int const FOLLOW_CHECK_MS = 1000; // collector killed without cleanup is noticed this late
+
+std::string log_dir(std::string const &container_id) {
+    return LOGS_DIR + "/" + container_id;
+}
+
+static std::string rotated_name(std::string const &dir, int index) {
+    return dir + "/" + LOG_FILE + (index ? "." + std::to_string(index) : "");
+}
+
+static bool collector_running(std::string const &dir);
+
+/*Collector side*******************************/
+
+static void remove_log_dir(std::string const &dir) {
+    DIR *dir_stream = opendir(dir.c_str());
+    if (dir_stream == nullptr) {
+        return;
+    }
+    while (dirent *entry = readdir(dir_stream)) {
+        std::string const name = entry->d_name;
+        if (name != "." && name != "..") {
+            unlink((dir + "/" + name).c_str());
+        }
+    }
+    closedir(dir_stream);
+    rmdir(dir.c_str());
+}
+
+void prune_exited_logs(bool debug_enabled) {
+    std::vector<std::pair<time_t, std::string>> exited; // by modification time
+    DIR *logs_stream = opendir(LOGS_DIR.c_str());
+    if (logs_stream == nullptr) {
+        return;
+    }
+    while (dirent *entry = readdir(logs_stream)) {
+        std::string const name = entry->d_name;
+        std::string const dir = log_dir(name);
+        struct stat dir_stat;
+        if (name != "." && name != ".." && stat(dir.c_str(), &dir_stat) == 0 && S_ISDIR(dir_stat.st_mode) &&
+                !collector_running(dir)) {
+            exited.push_back({dir_stat.st_mtime, dir});
+        }
+    }
+    closedir(logs_stream);
+    if (exited.size() <= static_cast<size_t>(MAX_EXITED_LOGS)) {
+        return;
+    }
+    std::sort(exited.begin(), exited.end());
+    for (size_t dir_idx = 0; dir_idx < exited.size() - MAX_EXITED_LOGS; ++dir_idx) {
+        if (debug_enabled) {
+            printDebug() << "Removing logs " << exited[dir_idx].second << std::endl;
+        }
+        remove_log_dir(exited[dir_idx].second);
+    }
+}
+
+// Rotated files are shifted by one, the oldest one is overwritten
+static void rotate(std::string const &dir, int files) {
+    if (files == 1) {
+        unlink(rotated_name(dir, 0).c_str());
+        return;
+    }
+    for (int index = files - 1; index > 0; --index) {
+        rename(rotated_name(dir, index - 1).c_str(), rotated_name(dir, index).c_str());
+    }
+}
+
+// Moves container output to ring without blocking on it: when ring is full
+// its oldest bytes are discarded to make room
+static void drain_container_output(int pipe_fd, int ring_in, int ring_out, int null_fd,
+                                   std::atomic<unsigned long long> &dropped) {
+    pollfd input = {pipe_fd, POLLIN, 0};
+    while (poll(&input, 1, -1) != -1 || errno == EINTR) {
+        ssize_t const moved = splice(pipe_fd, nullptr, ring_in, nullptr, SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved == 0) {
+            break; // all writers are gone
+        }
+        if (moved == -1 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+        if (moved != -1 || errno != EAGAIN) {
+            continue;
+        }
+        int pending = 0;
+        if (ioctl(pipe_fd, FIONREAD, &pending) == -1 || pending == 0) {
+            continue; // spurious wakeup, ring isn't full
+        }
+        ssize_t const discarded = splice(ring_out, nullptr, null_fd, nullptr, pending, SPLICE_F_NONBLOCK);
+        if (discarded > 0) {
+            dropped += discarded;
+        }
+    }
+}
+
+// Copies when file system can't splice
+static ssize_t copy_chunk(int from_fd, int to_fd, size_t size) {
+    char buffer[COPY_CHUNK];
+    ssize_t const got = read(from_fd, buffer, std::min(size, sizeof(buffer)));
+    if (got <= 0) {
+        return got;
+    }
+    for (ssize_t written = 0; written < got;) {
+        ssize_t const result = write(to_fd, buffer + written, got - written);
+        if (result == -1) {
+            return -1;
+        }
+        written += result;
+    }
+    return got;
+}
+
+static int open_log(std::string const &dir, unsigned long long &size) {
+    std::string const path = rotated_name(dir, 0);
+    // No O_APPEND: splice doesn't write to append mode files
+    int const fd = check_result(open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666), "Failed to open " + path);
+    off_t const end = lseek(fd, 0, SEEK_END);
+    if (end == -1) {
+        close(fd);
+        throw aucont_exception("Failed to seek " + path);
+    }
+    size = end;
+    return fd;
+}
+
+void run_log_collector(int pipe_fd, std::string const &container_id, unsigned long long max_size, int files,
+                       bool debug_enabled) {
+    // Container gets SIGPIPE if its output isn't read, so the collector
+    // outlives interrupted start and exits when container output is closed
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    std::string const dir = log_dir(container_id);
+    mkdir(LOGS_DIR.c_str(), 0777);
+    prune_exited_logs(debug_enabled);
+    mkdir(dir.c_str(), 0777);
+    std::string const collector_file = dir + "/" + COLLECTOR_FILE;
+    std::ofstream(collector_file) << getpid();
+
+    int ring[2];
+    check_result(pipe2(ring, O_CLOEXEC), "Failed to create log ring pipe");
+    int const ring_size = fcntl(ring[1], F_SETPIPE_SZ, RING_SIZE);
+    if (debug_enabled) {
+        printDebug() << "Log ring of " << container_id << " is "
+                     << (ring_size != -1 ? ring_size : fcntl(ring[1], F_GETPIPE_SZ)) << " bytes" << std::endl;
+    }
+
+    int const null_fd = check_result(open("/dev/null", O_WRONLY | O_CLOEXEC), "Failed to open /dev/null");
+    std::atomic<unsigned long long> dropped(0);
+    std::thread drainer([&]() {
+        drain_container_output(pipe_fd, ring[1], ring[0], null_fd, dropped);
+        close(ring[1]); // writer gets EOF after the rest of ring
+    });
+
+    unsigned long long size = 0;
+    unsigned long long reported_dropped = 0;
+    bool copy_fallback = false;
+    int log_fd = -1;
+    try {
+        log_fd = open_log(dir, size);
+        for (;;) {
+            if (size >= max_size) {
+                close(log_fd);
+                rotate(dir, files);
+                log_fd = open_log(dir, size);
+            }
+            size_t const chunk = std::min<unsigned long long>(SPLICE_CHUNK, max_size - size);
+            ssize_t moved = copy_fallback ? copy_chunk(ring[0], log_fd, chunk) :
+                                            splice(ring[0], nullptr, log_fd, nullptr, chunk, SPLICE_F_MOVE);
+            if (moved == -1 && errno == EINVAL && !copy_fallback) {
+                copy_fallback = true;
+                continue;
+            }
+            if (moved == -1 && errno == EINTR) {
+                continue;
+            }
+            check_result(moved, "Failed to write " + rotated_name(dir, 0));
+            if (moved == 0) {
+                break;
+            }
+            size += moved;
+
+            unsigned long long const dropped_now = dropped;
+            if (dropped_now != reported_dropped) {
+                std::string const marker = "\n[aucont: " + std::to_string(dropped_now - reported_dropped) +
+                        " bytes dropped]\n";
+                if (write(log_fd, marker.c_str(), marker.size()) > 0) {
+                    size += marker.size();
+                }
+                reported_dropped = dropped_now;
+            }
+        }
+    } catch(std::exception &e) {
+        // Output is discarded but still read: container must not get SIGPIPE because of full disk
+        std::cerr << "Log collector exception: " << e.what() << std::endl;
+        ssize_t discarded;
+        do {
+            discarded = splice(ring[0], nullptr, null_fd, nullptr, SPLICE_CHUNK, SPLICE_F_MOVE);
+        } while (discarded > 0 || (discarded == -1 && errno == EINTR));
+    }
+    drainer.join();
+    if (debug_enabled) {
+        printDebug() << "Log collector of " << container_id << " finished, " << dropped << " bytes dropped"
+                     << std::endl;
+    }
+    close(ring[0]);
+    close(null_fd);
+    if (log_fd != -1) {
+        close(log_fd);
+    }
+    close(pipe_fd);
+    unlink(collector_file.c_str());
+}
+
+/*Reader side**********************************/
+
+static bool is_dir(std::string const &path) {
+    struct stat path_stat;
+    return stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode);
+}
+
+// Logs outlive container registration, so dead containers are referred by id
+static std::string find_log_dir(std::string const &ref) {
+    if (!ref.empty() && ref.find('/') == std::string::npos && is_dir(log_dir(ref))) {
+        return log_dir(ref);
+    }
+    container_registry registry;
+    container_record record;
+    char* endptr = 0;
+    long const pid = strtol(ref.c_str(), &endptr, 10);
+    if (registry.find_by_id(ref, record) || registry.find_by_name(ref, record) ||
+            (*endptr == 0 && pid > 0 && registry.find_by_pid(pid, record))) {
+        if (is_dir(log_dir(record.id))) {
+            return log_dir(record.id);
+        }
+        throw aucont_exception("Container " + ref + " was started without --log");
+    }
+    throw aucont_exception("No logs of container " + ref);
+}
+
+// Rotated file indices, the oldest first
+static std::vector<int> rotated_indices(std::string const &dir) {
+    std::vector<int> indices;
+    DIR *dir_stream = opendir(dir.c_str());
+    if (dir_stream == nullptr) {
+        return indices;
+    }
+    std::string const prefix = LOG_FILE + ".";
+    while (dirent *entry = readdir(dir_stream)) {
+        std::string const name = entry->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > prefix.size()) {
+            indices.push_back(atoi(name.c_str() + prefix.size()));
+        }
+    }
+    closedir(dir_stream);
+    std::sort(indices.rbegin(), indices.rend());
+    return indices;
+}
+
+// Dir without collector pid file is exited container's one
+static bool collector_running(std::string const &dir) {
+    int pid = 0;
+    std::ifstream(dir + "/" + COLLECTOR_FILE) >> pid;
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+int aucont_logs(logs_arguments const &args) {
+    int inotify_fd = -1;
+    int log_fd = -1;
+    try {
+        std::string const dir = find_log_dir(args.id);
+        if (args.debug_enabled) {
+            printDebug() << "Log dir is " << dir << std::endl;
+        }
+        if (args.follow) { // before anything is read, so no write is missed
+            inotify_fd = check_result(inotify_init1(IN_CLOEXEC), "Failed to init inotify");
+            check_result(inotify_add_watch(inotify_fd, dir.c_str(), IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_DELETE),
+                         "Failed to watch " + dir);
+        }
+
+        std::cout.flush();
+        for (int index: rotated_indices(dir)) {
+            int const fd = open(rotated_name(dir, index).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd != -1) { // may be rotated away meanwhile
+                copy_fd(fd, STDOUT_FILENO);
+                close(fd);
+            }
+        }
+
+        std::string const path = rotated_name(dir, 0);
+        struct stat opened = {};
+        log_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (log_fd != -1) {
+            fstat(log_fd, &opened);
+        }
+        for (;;) {
+            bool const collector_done = !collector_running(dir); // then the rest is drained once more
+            if (log_fd != -1) {
+                copy_fd(log_fd, STDOUT_FILENO);
+            }
+            struct stat current;
+            if (args.follow && stat(path.c_str(), &current) == 0 &&
+                    (log_fd == -1 || current.st_ino != opened.st_ino)) { // rotated or created
+                if (log_fd != -1) {
+                    close(log_fd);
+                }
+                log_fd = check_result(open(path.c_str(), O_RDONLY | O_CLOEXEC), "Failed to open " + path);
+                opened = current;
+                continue;
+            }
+            if (!args.follow || collector_done) {
+                break;
+            }
+            pollfd events = {inotify_fd, POLLIN, 0};
+            if (poll(&events, 1, FOLLOW_CHECK_MS) > 0) {
+                char buffer[4096];
+                read(inotify_fd, buffer, sizeof(buffer));
+            }
+        }
+
+        if (log_fd != -1) {
+            close(log_fd);
+        }
+        if (inotify_fd != -1) {
+            close(inotify_fd);
+        }
+        return 0;
+    } catch(std::exception &e) {
+        if (log_fd != -1) {
+            close(log_fd);
+        }
+        if (inotify_fd != -1) {
+            close(inotify_fd);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
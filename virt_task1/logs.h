@@ -0,0 +1,25 @@
+#ifndef LOGS_H
+#define LOGS_H
+#include <string>
+
+// Container output captured with --log goes to LOGS_DIR/ID/container.log,
+// which is rotated to container.log.1 ... container.log.FILES-1. Logs of
+// exited containers are kept, only the last MAX_EXITED_LOGS of them.
+extern std::string const LOGS_DIR;
+extern int const MAX_EXITED_LOGS;
+
+std::string log_dir(std::string const &container_id);
+
+// Removes logs of the oldest exited containers beyond MAX_EXITED_LOGS
+void prune_exited_logs(bool debug_enabled);
+
+// Moves container output from pipe_fd to rotated files of max_size bytes
+// until all write ends of the pipe are closed. Bytes are spliced into a ring
+// pipe and from it into the file, they are copied through userspace only if
+// log file system can't splice.
+// If the disk is slower than the container, the oldest bytes of the ring are
+// dropped instead of blocking the container, and a marker is logged.
+void run_log_collector(int pipe_fd, std::string const &container_id, unsigned long long max_size, int files,
+                       bool debug_enabled);
+
+#endif // LOGS_H
@@ -6,8 +6,12 @@
 #include "error_codes.h"
 #include "stdlib.h"
 #include <signal.h>
+#include <string.h>
+#include <unistd.h>
 #include <iostream>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <vector>
 
 void print_option_error_message(option::Option const &opt, std::string const &err_msg) {
     std::cerr << "Option '" << opt.name  << "' " << err_msg;
@@ -45,35 +49,1199 @@ option::ArgStatus ip(const option::Option& option, bool print_err_msg) {
     return option::ARG_ILLEGAL;
 }
 
-enum  allOptionsIndex { UNKNOWN, HELP, DEBUG, DAEMONIZE, CPU_PERC, NET };
+option::ArgStatus net_mode(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr) {
+        std::string mode(option.arg);
+        if (mode == "veth" || mode == "macvlan" || mode == "ipvlan") {
+            return option::ARG_OK;
+        }
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires one of veth|macvlan|ipvlan\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus non_empty(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr && option.arg[0] != 0) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a non empty argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus pid(const option::Option& option, bool print_err_msg) {
+    char* endptr = 0;
+    long pid = 0;
+    if (option.arg != nullptr) {
+        pid = strtol(option.arg, &endptr, 10);
+    }
+    if (endptr != option.arg && *endptr == 0 && pid > 0) {
+      return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a positive numeric pid argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+bool parse_port(char const *str, char **endptr, unsigned short &port) {
+    long value = strtol(str, endptr, 10);
+    if (*endptr == str || value <= 0 || value > 65535) {
+        return false;
+    }
+    port = static_cast<unsigned short>(value);
+    return true;
+}
+
+bool parse_publish_spec(char const *str, publish_spec &spec) {
+    char* endptr = 0;
+    if (!parse_port(str, &endptr, spec.host_port) || *endptr != ':') {
+        return false;
+    }
+    char const *cont_port_str = endptr + 1;
+    return parse_port(cont_port_str, &endptr, spec.cont_port) && *endptr == 0;
+}
+
+option::ArgStatus port_mapping(const option::Option& option, bool print_err_msg) {
+    publish_spec spec;
+    if (option.arg != nullptr && parse_publish_spec(option.arg, spec)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires HOSTPORT:CONTPORT argument, ports are 1..65535\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus positive(const option::Option& option, bool print_err_msg) {
+    char* endptr = 0;
+    long value = 0;
+    if (option.arg != nullptr) {
+        value = strtol(option.arg, &endptr, 10);
+    }
+    if (endptr != option.arg && *endptr == 0 && value > 0) {
+      return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a positive numeric argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Converts "gro=off,tso=on" to ethtool -K arguments "gro off tso on"
+bool parse_offloads(char const *str, std::string &ethtool_args) {
+    std::string const offloads(str);
+    ethtool_args.clear();
+    size_t pos = 0;
+    while (pos <= offloads.size()) {
+        size_t end = offloads.find(',', pos);
+        if (end == std::string::npos) {
+            end = offloads.size();
+        }
+        std::string const item = offloads.substr(pos, end - pos);
+        size_t const eq = item.find('=');
+        if (eq == 0 || eq == std::string::npos) {
+            return false;
+        }
+        std::string const feature = item.substr(0, eq);
+        std::string const state = item.substr(eq + 1);
+        if (feature.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789-") != std::string::npos ||
+                (state != "on" && state != "off")) {
+            return false;
+        }
+        ethtool_args += (ethtool_args.empty() ? "" : " ") + feature + ' ' + state;
+        pos = end + 1;
+    }
+    return true;
+}
+
+option::ArgStatus offloads(const option::Option& option, bool print_err_msg) {
+    std::string ethtool_args;
+    if (option.arg != nullptr && parse_offloads(option.arg, ethtool_args)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires FEATURE=on|off[,FEATURE=on|off...] argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Checks tc(8) style NUMBER[UNIT] value, units are given in 'units'
+bool valid_tc_value(char const *str, std::vector<std::string> const &units) {
+    char* endptr = 0;
+    double value = strtod(str, &endptr);
+    if (endptr == str || value <= 0) {
+        return false;
+    }
+    std::string const unit(endptr);
+    return unit.empty() || std::find(units.begin(), units.end(), unit) != units.end();
+}
+
+option::ArgStatus tc_rate(const option::Option& option, bool print_err_msg) {
+    static std::vector<std::string> const RATE_UNITS = {"bit", "kbit", "mbit", "gbit", "tbit",
+                                                        "bps", "kbps", "mbps", "gbps", "tbps"};
+    if (option.arg != nullptr && valid_tc_value(option.arg, RATE_UNITS)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a rate argument like 100mbit or 10mbps\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus tc_size(const option::Option& option, bool print_err_msg) {
+    static std::vector<std::string> const SIZE_UNITS = {"b", "kb", "k", "mb", "m", "gb", "g",
+                                                        "kbit", "mbit", "gbit"};
+    if (option.arg != nullptr && valid_tc_value(option.arg, SIZE_UNITS)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a size argument like 32kb or 1mbit\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus net_prio(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr) {
+        std::string prio(option.arg);
+        if (prio == "interactive" || prio == "besteffort" || prio == "bulk") {
+            return option::ARG_OK;
+        }
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires one of interactive|besteffort|bulk\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus cpu_sched(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr) {
+        std::string sched(option.arg);
+        if (sched == "normal" || sched == "batch" || sched == "idle") {
+            return option::ARG_OK;
+        }
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires one of normal|batch|idle\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus list_format(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr) {
+        std::string format(option.arg);
+        if (format == "pids" || format == "json") {
+            return option::ARG_OK;
+        }
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires one of pids|json\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus cpu_period(const option::Option& option, bool print_err_msg) {
+    char* endptr = 0;
+    long period = 0;
+    if (option.arg != nullptr) {
+        period = strtol(option.arg, &endptr, 10);
+    }
+    if (endptr != option.arg && *endptr == 0 && period >= 1000 && period <= 1000000) {
+      return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a period in microseconds from 1000 to 1000000\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus non_negative(const option::Option& option, bool print_err_msg) {
+    char* endptr = 0;
+    long value = -1;
+    if (option.arg != nullptr) {
+        value = strtol(option.arg, &endptr, 10);
+    }
+    if (endptr != option.arg && *endptr == 0 && value >= 0) {
+      return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a non negative numeric argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Container paths are joined to image path, so they mustn't climb out of it
+bool has_parent_component(std::string const &path) {
+    return ("/" + path + "/").find("/../") != std::string::npos;
+}
+
+bool parse_volume_spec(char const *str, volume_spec &volume) {
+    std::string const spec(str);
+    size_t const first_colon = spec.find(':');
+    if (first_colon == std::string::npos) {
+        return false;
+    }
+    volume.host_path = spec.substr(0, first_colon);
+    volume.cont_path = spec.substr(first_colon + 1);
+    volume.read_only = false;
+    size_t const second_colon = volume.cont_path.find(':');
+    if (second_colon != std::string::npos) {
+        if (volume.cont_path.substr(second_colon + 1) != "ro") {
+            return false;
+        }
+        volume.read_only = true;
+        volume.cont_path.resize(second_colon);
+    }
+    return !volume.host_path.empty() && volume.cont_path.size() > 1 && volume.cont_path[0] == '/' &&
+            !has_parent_component(volume.cont_path);
+}
+
+option::ArgStatus volume(const option::Option& option, bool print_err_msg) {
+    volume_spec spec;
+    if (option.arg != nullptr && parse_volume_spec(option.arg, spec)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires HOST_PATH:CONT_PATH[:ro] argument, "
+                                           "CONT_PATH is absolute without '..'\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+bool parse_tmpfs_spec(char const *str, tmpfs_spec &tmpfs) {
+    std::string const spec(str);
+    size_t const colon = spec.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    tmpfs.cont_path = spec.substr(0, colon);
+    tmpfs.size = spec.substr(colon + 1);
+    char* endptr = 0;
+    long size = strtol(tmpfs.size.c_str(), &endptr, 10);
+    std::string const unit(endptr);
+    return tmpfs.cont_path.size() > 1 && tmpfs.cont_path[0] == '/' && !has_parent_component(tmpfs.cont_path) &&
+            endptr != tmpfs.size.c_str() &&
+            size > 0 && (unit.empty() || unit == "k" || unit == "m" || unit == "g" || unit == "%");
+}
+
+option::ArgStatus tmpfs(const option::Option& option, bool print_err_msg) {
+    tmpfs_spec spec;
+    if (option.arg != nullptr && parse_tmpfs_spec(option.arg, spec)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires CONT_PATH:SIZE argument, CONT_PATH is absolute without "
+                                           "'..', SIZE is NUMBER[k|m|g|%]\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Parses NUMBER[k|m|g] (binary units)
+bool parse_size(char const *str, unsigned long long &size) {
+    char* endptr = 0;
+    size = strtoull(str, &endptr, 10);
+    if (endptr == str || size == 0 || str[0] == '-') {
+        return false;
+    }
+    std::string const unit(endptr);
+    if (unit == "k" || unit == "K") {
+        size <<= 10;
+    } else if (unit == "m" || unit == "M") {
+        size <<= 20;
+    } else if (unit == "g" || unit == "G") {
+        size <<= 30;
+    } else if (!unit.empty()) {
+        return false;
+    }
+    return true;
+}
+
+option::ArgStatus size(const option::Option& option, bool print_err_msg) {
+    unsigned long long value;
+    if (option.arg != nullptr && parse_size(option.arg, value)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a positive NUMBER[k|m|g] argument\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+bool parse_hugepages_spec(char const *str, hugepages_spec &spec) {
+    std::string const arg(str);
+    size_t const colon = arg.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    char* endptr = 0;
+    std::string const count = arg.substr(colon + 1);
+    spec.count = strtoull(count.c_str(), &endptr, 10);
+    return parse_size(arg.substr(0, colon).c_str(), spec.page_size) &&
+            (spec.page_size & (spec.page_size - 1)) == 0 && spec.page_size >= (1 << 16) &&
+            endptr != count.c_str() && *endptr == 0 && spec.count > 0 && count[0] != '-';
+}
+
+option::ArgStatus hugepages(const option::Option& option, bool print_err_msg) {
+    hugepages_spec spec;
+    if (option.arg != nullptr && parse_hugepages_spec(option.arg, spec)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires PAGE_SIZE:COUNT argument, e.g. 2m:512 or 1g:4\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+option::ArgStatus io_weight(const option::Option& option, bool print_err_msg) {
+    char* endptr = 0;
+    long weight = 0;
+    if (option.arg != nullptr) {
+        weight = strtol(option.arg, &endptr, 10);
+    }
+    if (endptr != option.arg && *endptr == 0 && weight >= 10 && weight <= 1000) {
+      return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a numeric weight argument from 10 to 1000\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Parses DEVICE:NUMBER[k|m|g], DEVICE is path or MAJ:MIN, zero removes limit
+bool parse_io_limit(char const *str, io_limit_spec &spec) {
+    std::string const arg(str);
+    size_t const colon = arg.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        return false;
+    }
+    spec.device = arg.substr(0, colon);
+    std::string const value = arg.substr(colon + 1);
+    if (value == "0") {
+        spec.value = 0;
+        return true;
+    }
+    return parse_size(value.c_str(), spec.value);
+}
+
+option::ArgStatus io_limit(const option::Option& option, bool print_err_msg) {
+    io_limit_spec spec;
+    if (option.arg != nullptr && parse_io_limit(option.arg, spec)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires DEVICE:NUMBER[k|m|g] argument, "
+                                           "DEVICE is /dev path or MAJ:MIN, 0 removes limit\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Slice names must differ from container cgroup dirs named by pids
+bool valid_slice_name(char const *str) {
+    std::string const name(str);
+    return !name.empty() && isalpha(name[0]) &&
+            std::all_of(name.begin(), name.end(), [](char c) { return isalnum(c) || c == '_' || c == '-'; });
+}
+
+option::ArgStatus slice_name(const option::Option& option, bool print_err_msg) {
+    if (option.arg != nullptr && valid_slice_name(option.arg)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires a slice name: letter followed by letters, digits, '_' or '-'\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Parses comma separated percents 1..100
+bool parse_cpu_limits(char const *str, std::vector<int> &limits) {
+    limits.clear();
+    char const *begin = str;
+    while (true) {
+        char* endptr = 0;
+        long limit = strtol(begin, &endptr, 10);
+        if (endptr == begin || limit < 1 || limit > 100 || (*endptr != ',' && *endptr != 0)) {
+            return false;
+        }
+        limits.push_back(limit);
+        if (*endptr == 0) {
+            return true;
+        }
+        begin = endptr + 1;
+    }
+}
+
+option::ArgStatus cpu_limits(const option::Option& option, bool print_err_msg) {
+    std::vector<int> limits;
+    if (option.arg != nullptr && parse_cpu_limits(option.arg, limits)) {
+        return option::ARG_OK;
+    }
+
+    if (print_err_msg) {
+        print_option_error_message(option, "requires comma separated percents 1..100, e.g. 10,25,50\n");
+    }
+    return option::ARG_ILLEGAL;
+}
+
+// Container is referred by pid, id or name
+bool parse_container_ref(char const *str, int &pid) {
+    char* endptr = 0;
+    static size_t const CONTAINER_ID_LENGTH = 12; // pids are shorter
+    long const value = strtol(str, &endptr, 10);
+    if (endptr != str && *endptr == 0 && value > 0 && strlen(str) < CONTAINER_ID_LENGTH) {
+        pid = value;
+        return true;
+    }
+    try {
+        if (aucont_find_container(str, pid)) {
+            return true;
+        }
+        print_arg_error_message("PID", "should be numeric or id or name of registered container\n");
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+// IP - container ip address, IP+1 - host side ip address
+void parse_net_ips(char const *str, in_addr_t &cont_ip, in_addr_t &host_ip) {
+    inet_pton(AF_INET, str, &cont_ip);
+    host_ip = cont_ip;
+    host_ip = ntohl(host_ip);
+    host_ip += 1;
+    host_ip = ntohl(host_ip);
+}
+
+enum  allOptionsIndex { UNKNOWN, HELP, DEBUG, DAEMONIZE, CPU_PERC, NET, NET_MODE, NET_PARENT, JOIN, PUBLISH,
+                        UDP, DURATION, MSG_SIZE, SAMPLES, MTU, OFFLOADS, BASELINE, NET_QUEUES,
+                        NET_RATE, NET_BURST, NET_PRIO, VOLUME, TMPFS,
+                        MEM, TMP_SIZE, TMP_INODES, HUGEPAGES, FROM_TEMPLATE, PRELOAD, STOP, FREEZE_IDLE,
+                        IO_WEIGHT, IO_READ_BPS, IO_WRITE_BPS, IO_READ_IOPS, IO_WRITE_IOPS,
+                        SLICE, CPU_SHARES, CPU_PERIOD, CPU_BURST, CPU_SCHED,
+                        CPU_LIMITS, WORKERS, SAMPLE_MS,
+                        CLIENTS, OPS, LIST_PERCENT, KILLS, WATCHDOG, NAME, FORMAT,
+                        THROTTLE_INTERVAL, INTERVAL, COUNT,
+                        STEP, CPU_TARGET, CPU_MIN, CPU_MAX, MEMORY_TARGET, MEMORY_MIN, MEMORY_MAX,
+                        RECLAIM_IDLE, RECLAIM_PERCENT, RECLAIM_ONLY, LOG, LOG_SIZE, LOG_FILES, FOLLOW,
+                        TTY, INTERACTIVE, BATCH, JOBS, ENTRY };
 const option::Descriptor startUsage[] = {
-    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_start [options] IMAGE_PATH CMD [CMD_ARGS]\n\n"
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_start [options] IMAGE_PATH CMD [CMD_ARGS]\n"
+                                             "       ./aucont_start [options] --from-template NAME CMD [CMD_ARGS]\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {DAEMONIZE, 0, "d" , "daemonize", option::Arg::None, "  --daemonize, -d  \tdaemonize container." },
+    {LOG, 0, "", "log", option::Arg::None, "  --log  \tcapture container stdout and stderr into rotated "
+                                           "files instead of terminal or /dev/null, see aucont logs. "
+                                           "Output is dropped rather than slowing down container if disk "
+                                           "can't keep up." },
+    {LOG_SIZE, 0, "", "log-size", size, "  --log-size SIZE \tsize of a log file, NUMBER[k|m|g], default is 10m." },
+    {LOG_FILES, 0, "", "log-files", positive, "  --log-files N \tlog files kept including the current one, "
+                                              "default is 3." },
+    {CPU_PERC, 0, "", "cpu", percent, "  --cpu CPU_PERCENT \tpercent of cpu resources "
+                                                "allocated for container 0..100." },
+    {CPU_PERIOD, 0, "", "cpu-period", cpu_period, "  --cpu-period US \tCFS period of --cpu quota in "
+                                                  "microseconds, default is 100000. Longer periods let "
+                                                  "throttled container stall longer." },
+    {CPU_BURST, 0, "", "cpu-burst", positive, "  --cpu-burst US \tquota unused in previous periods "
+                                              "which container may spend at once (linux 5.14+)." },
+    {CPU_SHARES, 0, "", "cpu-shares", positive, "  --cpu-shares N \tcpu time share relative to other "
+                                                "containers when cpu is contended, default is 1024." },
+    {CPU_SCHED, 0, "", "sched", cpu_sched, "  --sched POLICY \tnormal|batch|idle scheduling policy of "
+                                           "container processes including exec'd ones, batch and idle "
+                                           "yield to normal tasks." },
+    {MEM, 0, "", "mem", size, "  --mem SIZE \tmemory limit of container (including /tmp), "
+                              "NUMBER[k|m|g]." },
+    {TMP_SIZE, 0, "", "tmp-size", size, "  --tmp-size SIZE \tsize limit of container /tmp, NUMBER[k|m|g]." },
+    {TMP_INODES, 0, "", "tmp-inodes", size, "  --tmp-inodes N \tinodes limit of container /tmp, NUMBER[k|m|g]." },
+    {HUGEPAGES, 0, "", "hugepages", hugepages, "  --hugepages PAGE_SIZE:COUNT \tallow container to use COUNT huge "
+                                               "pages of PAGE_SIZE (e.g. 2m:512) through hugetlbfs at "
+                                               "/dev/hugepages. Other sizes are mounted at "
+                                               "/dev/hugepages-2MB, /dev/hugepages-1GB, ..." },
+    {NET, 0, "", "net", ip, "  --net IP \tcreate virtual network between host and container. "
+                                           "IP ­- container ip address, IP+1 ­- host side ip address." },
+    {FROM_TEMPLATE, 0, "", "from-template", non_empty, "  --from-template NAME \tfork container from "
+                                                       "running template (see aucont template) instead of "
+                                                       "starting it from image. Networking, volumes, "
+                                                       "tmpfs and huge pages options aren't supported "
+                                                       "with it." },
+    {NAME, 0, "", "name", slice_name, "  --name NAME \tunique container name which can be used instead "
+                                      "of pid: letter followed by letters, digits, '_' or '-'." },
+    {SLICE, 0, "", "slice", slice_name, "  --slice NAME \tput container into slice created by aucont slice "
+                                        "create, slice limits are shared by its containers." },
+    {FREEZE_IDLE, 0, "", "freeze-idle", positive, "  --freeze-idle SECS \tfreeze container after SECS seconds "
+                                                  "without cpu usage. Frozen container is resumed by aucont "
+                                                  "resume or by connection to published port." },
+    {NET_MODE, 0, "", "net-mode", net_mode, "  --net-mode MODE \tveth|macvlan|ipvlan, default is veth. "
+                                            "macvlan and ipvlan attach container directly to NET_PARENT "
+                                            "and don't create host side interface." },
+    {NET_PARENT, 0, "", "net-parent", non_empty, "  --net-parent IFACE \thost interface for macvlan|ipvlan "
+                                                 "modes, default is a dummy interface." },
+    {JOIN, 0, "", "join", pid, "  --join PID \tshare network and ipc namespaces with running container PID. "
+                               "Mount, PID and UTS namespaces are still new. Can't be used with --net." },
+    {PUBLISH, 0, "p", "publish", port_mapping, "  --publish, -p HOSTPORT:CONTPORT \tforward TCP connections "
+                                               "from host port to container port. Requires --net in veth mode. "
+                                               "Can be repeated." },
+    {NET_QUEUES, 0, "", "net-queues", positive, "  --net-queues N \tnumber of tx and rx queues of container "
+                                                "interface (and of host veth end), default is 1." },
+    {MTU, 0, "", "mtu", positive, "  --mtu MTU \tMTU of container interface." },
+    {OFFLOADS, 0, "", "offloads", offloads, "  --offloads FEATURE=on|off[,...] \tethtool -K features of "
+                                            "container interface (both veth ends), e.g. gro=on,tso=off." },
+    {NET_RATE, 0, "", "net-rate", tc_rate, "  --net-rate RATE \tlimit container traffic in each direction, "
+                                           "e.g. 100mbit, shaped as a whole with htb unless --net-burst is given. "
+                                           "Requires --net in veth mode." },
+    {NET_BURST, 0, "", "net-burst", tc_size, "  --net-burst SIZE \tuse token bucket with SIZE burst "
+                                             "for --net-rate, e.g. 64kb." },
+    {NET_PRIO, 0, "", "net-prio", net_prio, "  --net-prio PRIO \tinteractive|besteffort|bulk, TOS set on "
+                                            "container packets, host qdiscs prioritize by it. "
+                                            "Requires --net in veth mode." },
+    {VOLUME, 0, "v", "volume", volume, "  --volume, -v HOST_PATH:CONT_PATH[:ro] \tbind mount host path "
+                                       "into container, read only with :ro. Can be repeated." },
+    {TMPFS, 0, "", "tmpfs", tmpfs, "  --tmpfs CONT_PATH:SIZE \tmount size limited tmpfs scratch dir, "
+                                   "e.g. /scratch:512m. Can be repeated." },
+    {0,0,0,0,0,0}
+};
+
+int aucont_start_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(startUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(startUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    int const image_args_count = options[FROM_TEMPLATE] ? 0 : 1;
+    if (options[HELP] || parse.nonOptionsCount() < image_args_count + 1) {
+        option::printUsage(std::cout, startUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    start_arguments args;
+    if (options[FROM_TEMPLATE]) {
+        static int const TEMPLATE_UNSUPPORTED[] = {NET, JOIN, PUBLISH, VOLUME, TMPFS, TMP_SIZE, TMP_INODES, HUGEPAGES};
+        for (int option_idx: TEMPLATE_UNSUPPORTED) {
+            if (options[option_idx]) {
+                print_arg_error_message(options[option_idx].name, "can't be used with --from-template\n");
+                return PARSE_ARG_ERROR;
+            }
+        }
+        args.template_name = options[FROM_TEMPLATE].arg;
+    } else {
+        args.image_path = parse.nonOption(0);
+    }
+    args.cmd = parse.nonOption(image_args_count);
+    args.cmd_args = const_cast<char*const*>(parse.nonOptions() + image_args_count);
+    args.cmd_args_count = parse.nonOptionsCount() - image_args_count - 1;
+    if (options[CPU_PERC]) {
+        args.cpu_limit = strtol(options[CPU_PERC].arg, nullptr, 10);
+    } else {
+        args.cpu_limit = 100;
+    }
+    if (options[CPU_PERIOD]) {
+        args.cpu_period_us = strtol(options[CPU_PERIOD].arg, nullptr, 10);
+    }
+    if (options[CPU_BURST]) {
+        args.cpu_burst_us = strtol(options[CPU_BURST].arg, nullptr, 10);
+    }
+    if (options[CPU_SHARES]) {
+        args.cpu_shares = strtol(options[CPU_SHARES].arg, nullptr, 10);
+    }
+    if (options[CPU_SCHED]) {
+        std::string sched(options[CPU_SCHED].arg);
+        args.cpu_sched = sched == "batch" ? CPU_SCHED_BATCH :
+                         sched == "idle" ? CPU_SCHED_IDLE : CPU_SCHED_NORMAL;
+    }
+    if (options[MEM]) {
+        parse_size(options[MEM].arg, args.memory_limit);
+    }
+    if (options[TMP_SIZE]) {
+        parse_size(options[TMP_SIZE].arg, args.tmp_size);
+    }
+    if (options[TMP_INODES]) {
+        parse_size(options[TMP_INODES].arg, args.tmp_inodes);
+    }
+    if (options[NAME]) {
+        args.name = options[NAME].arg;
+    }
+    if (options[SLICE]) {
+        args.slice = options[SLICE].arg;
+    }
+    if (options[FREEZE_IDLE]) {
+        args.freeze_idle_sec = strtol(options[FREEZE_IDLE].arg, nullptr, 10);
+    }
+    for (option::Option* opt = options[HUGEPAGES]; opt; opt = opt->next()) {
+        hugepages_spec spec;
+        parse_hugepages_spec(opt->arg, spec);
+        for (hugepages_spec const &added: args.hugepages) {
+            if (added.page_size == spec.page_size) { // both would get the same mount point and cgroup limit
+                print_arg_error_message("hugepages", "page size of " + std::string(opt->arg) + " is already given\n");
+                return PARSE_ARG_ERROR;
+            }
+        }
+        args.hugepages.push_back(spec);
+    }
+    if (options[NET]) {
+        parse_net_ips(options[NET].arg, args.cont_ip, args.host_ip);
+    }
+    args.net_enabled = options[NET];
+    if ((options[NET_MODE] || options[NET_PARENT]) && !options[NET]) {
+        print_arg_error_message(options[NET_MODE] ? "net-mode" : "net-parent", "requires --net\n");
+        return PARSE_ARG_ERROR;
+    }
+    args.net_mode = NET_MODE_VETH;
+    if (options[NET_MODE]) {
+        std::string mode(options[NET_MODE].arg);
+        if (mode == "macvlan") {
+            args.net_mode = NET_MODE_MACVLAN;
+        } else if (mode == "ipvlan") {
+            args.net_mode = NET_MODE_IPVLAN;
+        }
+    }
+    if (options[NET_PARENT]) {
+        if (args.net_mode == NET_MODE_VETH) {
+            print_arg_error_message("net-parent", "requires --net-mode macvlan or ipvlan\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.net_parent = options[NET_PARENT].arg;
+    }
+    if (options[JOIN]) {
+        if (options[NET]) {
+            print_arg_error_message("join", "can't be used together with --net\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.join_pid = strtol(options[JOIN].arg, nullptr, 10);
+    } else {
+        args.join_pid = 0;
+    }
+    for (option::Option* opt = options[PUBLISH]; opt; opt = opt->next()) {
+        if (!options[NET] || args.net_mode != NET_MODE_VETH) {
+            print_arg_error_message("publish", "requires --net in veth mode\n");
+            return PARSE_ARG_ERROR;
+        }
+        publish_spec spec;
+        parse_publish_spec(opt->arg, spec);
+        args.publish.push_back(spec);
+    }
+    if ((options[NET_RATE] || options[NET_PRIO]) && (!options[NET] || args.net_mode != NET_MODE_VETH)) {
+        print_arg_error_message(options[NET_RATE] ? "net-rate" : "net-prio", "requires --net in veth mode\n");
+        return PARSE_ARG_ERROR;
+    }
+    if (options[NET_BURST] && !options[NET_RATE]) {
+        print_arg_error_message("net-burst", "requires --net-rate\n");
+        return PARSE_ARG_ERROR;
+    }
+    if (options[NET_RATE]) {
+        args.net_rate = options[NET_RATE].arg;
+    }
+    if (options[NET_BURST]) {
+        args.net_burst = options[NET_BURST].arg;
+    }
+    if (options[NET_PRIO]) {
+        std::string prio(options[NET_PRIO].arg);
+        args.net_prio = prio == "interactive" ? NET_PRIO_INTERACTIVE :
+                        prio == "bulk" ? NET_PRIO_BULK : NET_PRIO_BESTEFFORT;
+    }
+    for (option::Option* opt = options[VOLUME]; opt; opt = opt->next()) {
+        volume_spec spec;
+        parse_volume_spec(opt->arg, spec);
+        args.volumes.push_back(spec);
+    }
+    for (option::Option* opt = options[TMPFS]; opt; opt = opt->next()) {
+        tmpfs_spec spec;
+        parse_tmpfs_spec(opt->arg, spec);
+        args.tmpfs_mounts.push_back(spec);
+    }
+    if (options[NET_QUEUES]) {
+        args.net_queues = strtol(options[NET_QUEUES].arg, nullptr, 10);
+    }
+    if (options[MTU]) {
+        args.mtu = strtol(options[MTU].arg, nullptr, 10);
+    }
+    if (options[OFFLOADS]) {
+        parse_offloads(options[OFFLOADS].arg, args.offloads);
+    }
+    if ((options[LOG_SIZE] || options[LOG_FILES]) && !options[LOG]) {
+        print_arg_error_message(options[LOG_SIZE] ? "log-size" : "log-files", "requires --log\n");
+        return PARSE_ARG_ERROR;
+    }
+    args.log_enabled = options[LOG];
+    if (options[LOG_SIZE]) {
+        parse_size(options[LOG_SIZE].arg, args.log_size);
+    }
+    if (options[LOG_FILES]) {
+        args.log_files = strtol(options[LOG_FILES].arg, nullptr, 10);
+    }
+    args.daemonize = options[DAEMONIZE];
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_start(args);
+}
+
+const option::Descriptor stopUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_stop [options] PID [SIGTERM]\n"
+                                             "Kills root container process with signal and cleans up container resources\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "PID ­ container init process pid in its parent PID namespace, container id or name\n"
+        "SIG_NUM ­ number of signal to send to container process\n"
+                  "\tdefault is SIGTERM (15)" },
+    {0,0,0,0,0,0}
+};
+
+int aucont_stop_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(stopUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(stopUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() < 1) {
+        option::printUsage(std::cout, stopUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    stop_arguments args;
+    char* endptr = 0;
+    if (!parse_container_ref(parse.nonOption(0), args.pid)) {
+        return PARSE_ARG_ERROR;
+    }
+    if (parse.nonOptionsCount() >= 2) {
+        args.signal = strtol(parse.nonOption(1), &endptr, 10);
+        if (endptr == parse.nonOption(1) || *endptr != 0) {
+            print_arg_error_message("SIGNAL", "should be numeric\n");
+            return PARSE_ARG_ERROR;
+        }
+    } else {
+        args.signal = SIGTERM;
+    }
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_stop(args);
+}
+
+const option::Descriptor pauseUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_pause PID\n"
+                                             "Freezes all container processes\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "PID ­ container init process pid in its parent PID namespace, container id or name" },
+    {0,0,0,0,0,0}
+};
+
+const option::Descriptor resumeUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_resume PID\n"
+                                             "Thaws container frozen by aucont pause or --freeze-idle\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "PID ­ container init process pid in its parent PID namespace, container id or name" },
+    {0,0,0,0,0,0}
+};
+
+int aucont_pause_resume_main(int argc, char *argv[], option::Descriptor const usage[],
+                             int (*command)(pause_arguments const &)) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() != 1) {
+        option::printUsage(std::cout, usage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    pause_arguments args;
+    if (!parse_container_ref(parse.nonOption(0), args.pid)) {
+        return PARSE_ARG_ERROR;
+    }
+    args.debug_enabled = options[DEBUG];
+
+    return command(args);
+}
+
+const option::Descriptor updateUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_update [options] PID\n"
+                                             "Changes resource limits of running container. Either all "
+                                             "limits are changed or none\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {CPU_PERC, 0, "", "cpu", percent, "  --cpu CPU_PERCENT \tpercent of cpu resources "
+                                      "allocated for container 0..100." },
+    {CPU_PERIOD, 0, "", "cpu-period", cpu_period, "  --cpu-period US \tCFS period in microseconds, "
+                                                  "quota is scaled to keep cpu percent." },
+    {CPU_BURST, 0, "", "cpu-burst", non_negative, "  --cpu-burst US \tCFS burst in microseconds, "
+                                                  "0 disables burst." },
+    {CPU_SHARES, 0, "", "cpu-shares", positive, "  --cpu-shares N \tcpu time share of container." },
+    {MEM, 0, "", "mem", size, "  --mem SIZE \tmemory limit of container, NUMBER[k|m|g]. "
+                              "Fails if container uses more." },
+    {IO_WEIGHT, 0, "", "io-weight", io_weight, "  --io-weight WEIGHT \tproportional block io weight "
+                                               "10..1000 (requires cfq/bfq scheduler)." },
+    {IO_READ_BPS, 0, "", "io-read-bps", io_limit, "  --io-read-bps DEVICE:RATE \tlimit read bytes per "
+                                                  "second from device. Can be repeated." },
+    {IO_WRITE_BPS, 0, "", "io-write-bps", io_limit, "  --io-write-bps DEVICE:RATE \tlimit write bytes per "
+                                                    "second to device. Can be repeated." },
+    {IO_READ_IOPS, 0, "", "io-read-iops", io_limit, "  --io-read-iops DEVICE:RATE \tlimit read operations "
+                                                    "per second from device. Can be repeated." },
+    {IO_WRITE_IOPS, 0, "", "io-write-iops", io_limit, "  --io-write-iops DEVICE:RATE \tlimit write "
+                                                      "operations per second to device. Can be repeated." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "PID ­ container init process pid in its parent PID namespace, container id or name" },
+    {0,0,0,0,0,0}
+};
+
+int aucont_update_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(updateUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(updateUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() != 1) {
+        option::printUsage(std::cout, updateUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    update_arguments args;
+    if (!parse_container_ref(parse.nonOption(0), args.pid)) {
+        return PARSE_ARG_ERROR;
+    }
+    if (options[CPU_PERC]) {
+        args.cpu_limit = strtol(options[CPU_PERC].arg, nullptr, 10);
+    }
+    if (options[MEM]) {
+        parse_size(options[MEM].arg, args.memory_limit);
+    }
+    if (options[CPU_PERIOD]) {
+        args.cpu_period_us = strtol(options[CPU_PERIOD].arg, nullptr, 10);
+    }
+    if (options[CPU_BURST]) {
+        args.cpu_burst_us = strtol(options[CPU_BURST].arg, nullptr, 10);
+    }
+    if (options[CPU_SHARES]) {
+        args.cpu_shares = strtol(options[CPU_SHARES].arg, nullptr, 10);
+    }
+    if (options[IO_WEIGHT]) {
+        args.io_weight = strtol(options[IO_WEIGHT].arg, nullptr, 10);
+    }
+    static std::pair<int, io_limit_t> const IO_LIMIT_OPTIONS[] = {
+        {IO_READ_BPS, IO_LIMIT_READ_BPS}, {IO_WRITE_BPS, IO_LIMIT_WRITE_BPS},
+        {IO_READ_IOPS, IO_LIMIT_READ_IOPS}, {IO_WRITE_IOPS, IO_LIMIT_WRITE_IOPS}
+    };
+    for (auto const &limit_option: IO_LIMIT_OPTIONS) {
+        for (option::Option* opt = options[limit_option.first]; opt; opt = opt->next()) {
+            io_limit_spec spec;
+            parse_io_limit(opt->arg, spec);
+            spec.type = limit_option.second;
+            args.io_limits.push_back(spec);
+        }
+    }
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_update(args);
+}
+
+const option::Descriptor sliceUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_slice create|update|remove NAME [options]\n"
+                                             "       ./aucont_slice list\n"
+                                             "Manages slices: parent cgroups of containers started with "
+                                             "--slice NAME\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {CPU_PERC, 0, "", "cpu", percent, "  --cpu CPU_PERCENT \tpercent of cpu resources "
+                                      "shared by all slice containers 0..100." },
+    {MEM, 0, "", "mem", size, "  --mem SIZE \tmemory limit of all slice containers, NUMBER[k|m|g]." },
+    {CPU_SHARES, 0, "", "shares", positive, "  --shares N \tcpu share of slice relative to other slices "
+                                            "and top level containers, default is 1024." },
+    {0,0,0,0,0,0}
+};
+
+static const std::string SLICE_CREATE_ACTION("create");
+static const std::string SLICE_UPDATE_ACTION("update");
+static const std::string SLICE_REMOVE_ACTION("remove");
+static const std::string SLICE_LIST_ACTION("list");
+
+int aucont_slice_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(sliceUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(sliceUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() < 1) {
+        option::printUsage(std::cout, sliceUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    std::string const action(parse.nonOption(0));
+    if (action == SLICE_LIST_ACTION) {
+        return aucont_slice_list();
+    }
+    if (action != SLICE_CREATE_ACTION && action != SLICE_UPDATE_ACTION && action != SLICE_REMOVE_ACTION) {
+        option::printUsage(std::cout, sliceUsage);
+        return INVALID_ARGS_ERROR;
+    }
+    if (parse.nonOptionsCount() != 2 || !valid_slice_name(parse.nonOption(1))) {
+        print_arg_error_message("NAME", "should be a letter followed by letters, digits, '_' or '-'\n");
+        return PARSE_ARG_ERROR;
+    }
+
+    slice_arguments args;
+    args.name = parse.nonOption(1);
+    if (options[CPU_PERC]) {
+        args.cpu_limit = strtol(options[CPU_PERC].arg, nullptr, 10);
+    }
+    if (options[MEM]) {
+        parse_size(options[MEM].arg, args.memory_limit);
+    }
+    if (options[CPU_SHARES]) {
+        args.cpu_shares = strtol(options[CPU_SHARES].arg, nullptr, 10);
+    }
+    args.debug_enabled = options[DEBUG];
+
+    if (action == SLICE_CREATE_ACTION) {
+        return aucont_slice_create(args);
+    }
+    if (action == SLICE_UPDATE_ACTION) {
+        return aucont_slice_update(args);
+    }
+    return aucont_slice_remove(args);
+}
+
+const option::Descriptor listUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_list\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {FORMAT, 0, "" , "format", list_format, "  --format FORMAT \tpids|json, json prints all registry "
+                                            "record fields: id, name, pid, image, cmd, start_time, "
+                                            "cpu_limit, memory_limit, ip and cgroup." },
+    {0,0,0,0,0,0}
+};
+
+int aucont_list_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(listUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(listUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP]) {
+        option::printUsage(std::cout, listUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    list_arguments args;
+    if (options[FORMAT]) {
+        args.format = std::string(options[FORMAT].arg) == "json" ? LIST_FORMAT_JSON : LIST_FORMAT_PIDS;
+    }
+
+    return aucont_list(args);
+}
+
+const option::Descriptor execUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_exec [options] PID CMD [ARGS]\n"
+                                             "       ./aucont_exec [options] --batch FILE PID\n"
+                                             "Runs command inside container and exits with its exit code "
+                                             "(128 + N if it was killed by signal N)\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {INTERACTIVE, 0, "i", "interactive", option::Arg::None, "  --interactive, -i  \tgive command pipes "
+                                                            "relayed to our stdio instead of our fds, "
+                                                            "stdin is forwarded until EOF." },
+    {TTY, 0, "t", "tty", option::Arg::None, "  --tty, -t  \trun command in pseudo terminal, stdout and "
+                                            "stderr are merged. Our stdin is forwarded with -i, our "
+                                            "terminal is switched to raw mode then." },
+    {BATCH, 0, "", "batch", non_empty, "  --batch FILE \trun commands from FILE (- for stdin), one "
+                                       "CMD [ARGS] per line, words may be quoted. Container is entered "
+                                       "once for all of them. Output of every command is printed "
+                                       "after its exit status as soon as it finishes. Exit code is the "
+                                       "one of the first failed command in FILE order." },
+    {JOBS, 0, "j", "jobs", positive, "  --jobs, -j N \trun up to N batch commands at once, default is 1." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "PID ­ container init process pid in its parent PID namespace, container id or name\n"
+        "CMD ­ command to run inside container\n"
+        "ARGS ­ arguments for CMD" },
+    {0,0,0,0,0,0}
+};
+
+int aucont_exec_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(execUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(execUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() < (options[BATCH] ? 1 : 2)) {
+        option::printUsage(std::cout, execUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    exec_arguments args;
+    if (!parse_container_ref(parse.nonOption(0), args.pid)) {
+        return PARSE_ARG_ERROR;
+    }
+    if (options[BATCH]) {
+        if (parse.nonOptionsCount() > 1 || options[TTY] || options[INTERACTIVE]) {
+            print_arg_error_message("batch", "can't be used with CMD, --tty or --interactive\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.batch_file = options[BATCH].arg;
+        args.cmd_args = nullptr;
+        args.cmd_args_count = 0;
+    } else {
+        args.cmd = parse.nonOption(1);
+        args.cmd_args = const_cast<char*const*>(parse.nonOptions() + 1);
+        args.cmd_args_count = parse.nonOptionsCount() - 2;
+    }
+    if (options[JOBS]) {
+        if (!options[BATCH]) {
+            print_arg_error_message("jobs", "requires --batch\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.jobs = strtol(options[JOBS].arg, nullptr, 10);
+    }
+    args.tty = options[TTY];
+    args.interactive = options[INTERACTIVE];
+    args.debug_enabled = options[DEBUG];
+
+
+    return aucont_exec(args);
+}
+
+const option::Descriptor templateUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont template [options] NAME IMAGE_PATH\n"
+                                             "       ./aucont template --stop NAME\n"
+                                             "Starts zygote process which enters IMAGE_PATH once, preloads "
+                                             "libraries and then forks containers for "
+                                             "'aucont start --from-template NAME'. Containers exec CMD, so "
+                                             "only namespace and mount setup and page cache are shared, unless "
+                                             "--entry is given. Prints zygote pid.\n\n"
                                              "Options:" },
     {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
     {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
-    {DAEMONIZE, 0, "d" , "daemonize", option::Arg::None, "  --daemonize, -d  \tdaemonize container." },
-    {CPU_PERC, 0, "", "cpu", percent, "  --cpu CPU_PERCENT \tpercent of cpu resources "
-                                                "allocated for container 0..100." },
-    {NET, 0, "", "net", ip, "  --net IP \tcreate virtual network between host and container. "
-                                           "IP ­- container ip address, IP+1 ­- host side ip address." },
+    {PRELOAD, 0, "", "preload", non_empty, "  --preload LIBRARY \tlibrary (path inside image) to load "
+                                           "into zygote. Can be repeated." },
+    {ENTRY, 0, "", "entry", non_empty, "  --entry SYMBOL \tint SYMBOL(int argc, char *argv[]) of preloaded "
+                                       "library, called with CMD and CMD_ARGS in forked container instead of "
+                                       "exec, so it shares state initialized by preload." },
+    {STOP, 0, "", "stop", option::Arg::None, "  --stop  \tstop zygote of template NAME." },
     {0,0,0,0,0,0}
 };
 
-int aucont_start_main(int argc, char *argv[]) {
+int aucont_template_main(int argc, char *argv[]) {
     if (argc) {
         argc -= 1;
         argv += 1;
     }
-    option::Stats  stats(startUsage, argc, argv);
+    option::Stats  stats(templateUsage, argc, argv);
     option::Option options[stats.options_max], buffer[stats.buffer_max];
-    option::Parser parse(startUsage, argc, argv, options, buffer);
+    option::Parser parse(templateUsage, argc, argv, options, buffer);
 
     if (parse.error()) {
         return PARSE_OPTIONS_ERROR;
     }
 
-    if (options[HELP] || parse.nonOptionsCount() < 2) {
-        option::printUsage(std::cout, startUsage);
+    if (options[HELP] || parse.nonOptionsCount() < (options[STOP] ? 1 : 2)) {
+        option::printUsage(std::cout, templateUsage);
         return 0;
     }
 
@@ -81,58 +1249,183 @@ int aucont_start_main(int argc, char *argv[]) {
         std::cout << "Unknown option: " << opt->name << "\n";
     }
 
-    start_arguments args;
+    template_arguments args;
+    args.name = parse.nonOption(0);
+    if (args.name.find('/') != std::string::npos) {
+        print_arg_error_message("NAME", "should not contain '/'\n");
+        return PARSE_ARG_ERROR;
+    }
+    if (!options[STOP]) {
+        args.image_path = parse.nonOption(1);
+    }
+    for (option::Option* opt = options[PRELOAD]; opt; opt = opt->next()) {
+        args.preload.push_back(opt->arg);
+    }
+    if (options[ENTRY]) {
+        if (args.preload.empty()) {
+            print_arg_error_message("entry", "requires --preload\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.entry = options[ENTRY].arg;
+    }
+    args.stop = options[STOP];
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_template(args);
+}
+
+const option::Descriptor benchNetUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont bench-net [options] --net IP IMAGE_PATH CMD [CMD_ARGS]\n"
+                                             "Starts daemonized container running CMD, measures throughput and "
+                                             "latency between host and container over veth and stops container\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {NET, 0, "", "net", ip, "  --net IP \tcontainer ip address, IP+1 - host side ip address." },
+    {UDP, 0, "", "udp", option::Arg::None, "  --udp  \tuse UDP instead of TCP." },
+    {DURATION, 0, "", "duration", positive, "  --duration SECONDS \tthroughput phase duration, default is 5." },
+    {MSG_SIZE, 0, "", "msg-size", positive, "  --msg-size BYTES \tsize of sent messages, "
+                                            "default is 65536 for TCP and 1400 for UDP." },
+    {SAMPLES, 0, "", "latency-samples", positive, "  --latency-samples N \tround trips measured, default is 10000." },
+    {NET_QUEUES, 0, "", "net-queues", positive, "  --net-queues N \tnumber of veth tx and rx queues." },
+    {MTU, 0, "", "mtu", positive, "  --mtu MTU \tveth MTU." },
+    {OFFLOADS, 0, "", "offloads", offloads, "  --offloads FEATURE=on|off[,...] \tethtool -K features of both "
+                                            "veth ends, e.g. gro=off,tso=off." },
+    {BASELINE, 0, "", "baseline", option::Arg::None, "  --baseline  \talso measure host loopback for comparison." },
+    {0,0,0,0,0,0}
+};
+
+int aucont_bench_net_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(benchNetUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(benchNetUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() < 2 || !options[NET]) {
+        option::printUsage(std::cout, benchNetUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    bench_net_arguments args;
     args.image_path = parse.nonOption(0);
     args.cmd = parse.nonOption(1);
     args.cmd_args = const_cast<char*const*>(parse.nonOptions() + 1);
     args.cmd_args_count = parse.nonOptionsCount() - 2;
-    if (options[CPU_PERC]) {
-        args.cpu_limit = strtol(options[CPU_PERC].arg, nullptr, 10);
-    } else {
-        args.cpu_limit = 100;
+    parse_net_ips(options[NET].arg, args.cont_ip, args.host_ip);
+    args.udp = options[UDP];
+    args.duration_sec = options[DURATION] ? strtol(options[DURATION].arg, nullptr, 10) : 5;
+    args.msg_size = options[MSG_SIZE] ? strtol(options[MSG_SIZE].arg, nullptr, 10) : (args.udp ? 1400 : 1 << 16);
+    args.latency_samples = options[SAMPLES] ? strtol(options[SAMPLES].arg, nullptr, 10) : 10000;
+    args.net_queues = options[NET_QUEUES] ? strtol(options[NET_QUEUES].arg, nullptr, 10) : 1;
+    args.mtu = options[MTU] ? strtol(options[MTU].arg, nullptr, 10) : 0;
+    if (options[OFFLOADS]) {
+        parse_offloads(options[OFFLOADS].arg, args.offloads);
     }
-    if (options[NET]) {
-        inet_pton(AF_INET, options[NET].arg, &args.cont_ip);
-        args.host_ip = args.cont_ip;
-        args.host_ip = ntohl(args.host_ip);
-        args.host_ip += 1;
-        args.host_ip = ntohl(args.host_ip);
+    args.baseline = options[BASELINE];
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_bench_net(args);
+}
+
+const option::Descriptor benchCpuUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont bench-cpu [options] --cpus LIST IMAGE_PATH CMD [CMD_ARGS]\n"
+                                             "Starts daemonized container running CMD for each cpu limit, loads "
+                                             "them with spin loops and reports achieved cpu against fair share "
+                                             "of requested limits, error and throttle stall distributions\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {CPU_LIMITS, 0, "", "cpus", cpu_limits, "  --cpus LIST \t--cpu percents of containers, e.g. 10,25,50." },
+    {WORKERS, 0, "", "workers", positive, "  --workers N \tspinners per container, default is cpus count." },
+    {DURATION, 0, "", "duration", positive, "  --duration SECONDS \tmeasurement duration, default is 10." },
+    {SAMPLE_MS, 0, "", "sample-ms", positive, "  --sample-ms MS \tsampling interval, default is 500." },
+    {CPU_PERIOD, 0, "", "cpu-period", cpu_period, "  --cpu-period US \tCFS period of containers." },
+    {0,0,0,0,0,0}
+};
+
+int aucont_bench_cpu_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
     }
-    args.net_enabled = options[NET];
-    args.daemonize = options[DAEMONIZE];
+    option::Stats  stats(benchCpuUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(benchCpuUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() < 2 || !options[CPU_LIMITS]) {
+        option::printUsage(std::cout, benchCpuUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    bench_cpu_arguments args;
+    args.image_path = parse.nonOption(0);
+    args.cmd = parse.nonOption(1);
+    args.cmd_args = const_cast<char*const*>(parse.nonOptions() + 1);
+    args.cmd_args_count = parse.nonOptionsCount() - 2;
+    parse_cpu_limits(options[CPU_LIMITS].arg, args.cpu_limits);
+    args.workers = options[WORKERS] ? strtol(options[WORKERS].arg, nullptr, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    args.duration_sec = options[DURATION] ? strtol(options[DURATION].arg, nullptr, 10) : 10;
+    args.sample_ms = options[SAMPLE_MS] ? strtol(options[SAMPLE_MS].arg, nullptr, 10) : 500;
+    args.cpu_period_us = options[CPU_PERIOD] ? strtol(options[CPU_PERIOD].arg, nullptr, 10) : 0;
     args.debug_enabled = options[DEBUG];
 
-    return aucont_start(args);
+    return aucont_bench_cpu(args);
 }
 
-const option::Descriptor stopUsage[] = {
-    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_stop [options] PID [SIGTERM]\n"
-                                             "Kills root container process with signal and cleans up container resources\n\n"
+const option::Descriptor benchRegistryUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont bench-registry [options]\n"
+                                             "Runs concurrent processes adding, removing and listing records "
+                                             "against private copy of container registry, kills some of them "
+                                             "with SIGKILL and reports throughput, lock wait and lost or "
+                                             "duplicate pids\n\n"
                                              "Options:" },
     {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
     {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
-    {UNKNOWN, 0, "" , "", option::Arg::None,
-        "PID ­ container init process pid in its parent PID namespace\n"
-        "SIG_NUM ­ number of signal to send to container process\n"
-                  "\tdefault is SIGTERM (15)" },
+    {CLIENTS, 0, "", "clients", positive, "  --clients N \tconcurrent clients 1..2000, default is 200." },
+    {OPS, 0, "", "ops", positive, "  --ops N \toperations per client, default is 200." },
+    {LIST_PERCENT, 0, "", "list-percent", percent, "  --list-percent P \tpercent of list operations, "
+                                                   "default is 10." },
+    {KILLS, 0, "", "kills", non_negative, "  --kills N \tclients killed with SIGKILL, default is 0. "
+                                          "If set, clients are also killed during removals." },
+    {WATCHDOG, 0, "", "watchdog", positive, "  --watchdog SECONDS \treport deadlock after this long "
+                                            "without progress, default is 5." },
     {0,0,0,0,0,0}
 };
 
-int aucont_stop_main(int argc, char *argv[]) {
+int aucont_bench_registry_main(int argc, char *argv[]) {
     if (argc) {
         argc -= 1;
         argv += 1;
     }
-    option::Stats  stats(stopUsage, argc, argv);
+    option::Stats  stats(benchRegistryUsage, argc, argv);
     option::Option options[stats.options_max], buffer[stats.buffer_max];
-    option::Parser parse(stopUsage, argc, argv, options, buffer);
+    option::Parser parse(benchRegistryUsage, argc, argv, options, buffer);
 
     if (parse.error()) {
         return PARSE_OPTIONS_ERROR;
     }
 
-    if (options[HELP] || parse.nonOptionsCount() < 1) {
-        option::printUsage(std::cout, stopUsage);
+    if (options[HELP]) {
+        option::printUsage(std::cout, benchRegistryUsage);
         return 0;
     }
 
@@ -140,49 +1433,51 @@ int aucont_stop_main(int argc, char *argv[]) {
         std::cout << "Unknown option: " << opt->name << "\n";
     }
 
-    stop_arguments args;
-    char* endptr = 0;
-    args.pid = strtol(parse.nonOption(0), &endptr, 10);
-    if (endptr == parse.nonOption(0) || *endptr != 0) {
-        print_arg_error_message("PID", "should be numeric\n");
+    static int const MAX_CLIENTS = 2000; // fake pids must fit int
+    static int const MAX_OPS = 1000000;
+    bench_registry_arguments args;
+    args.clients = options[CLIENTS] ? strtol(options[CLIENTS].arg, nullptr, 10) : 200;
+    args.ops = options[OPS] ? strtol(options[OPS].arg, nullptr, 10) : 200;
+    if (args.clients > MAX_CLIENTS || args.ops >= MAX_OPS) {
+        print_arg_error_message(args.clients > MAX_CLIENTS ? "clients" : "ops", "is too large\n");
         return PARSE_ARG_ERROR;
     }
-    if (parse.nonOptionsCount() >= 2) {
-        args.signal = strtol(parse.nonOption(1), &endptr, 10);
-        if (endptr == parse.nonOption(1) || *endptr != 0) {
-            print_arg_error_message("SIGNAL", "should be numeric\n");
-            return PARSE_ARG_ERROR;
-        }
-    } else {
-        args.signal = SIGTERM;
-    }
+    args.list_percent = options[LIST_PERCENT] ? strtol(options[LIST_PERCENT].arg, nullptr, 10) : 10;
+    args.kills = options[KILLS] ? strtol(options[KILLS].arg, nullptr, 10) : 0;
+    args.watchdog_sec = options[WATCHDOG] ? strtol(options[WATCHDOG].arg, nullptr, 10) : 5;
+    args.file_name = "/tmp/aucont_bench_registry_" + std::to_string(getpid());
     args.debug_enabled = options[DEBUG];
 
-    return aucont_stop(args);
+    return aucont_bench_registry(args);
 }
 
-const option::Descriptor listUsage[] = {
-    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_list\n\n"
+const option::Descriptor eventsUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_events [options]\n"
+                                             "Prints container events as JSON lines until interrupted: "
+                                             "start, stop, update, pause, resume, exit, oom and throttle\n\n"
                                              "Options:" },
     {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {THROTTLE_INTERVAL, 0, "", "throttle-interval", positive, "  --throttle-interval MS \tcpu.stat polling "
+                                                              "interval, default is 1000." },
     {0,0,0,0,0,0}
 };
 
-int aucont_list_main(int argc, char *argv[]) {
+int aucont_events_main(int argc, char *argv[]) {
     if (argc) {
         argc -= 1;
         argv += 1;
     }
-    option::Stats  stats(listUsage, argc, argv);
+    option::Stats  stats(eventsUsage, argc, argv);
     option::Option options[stats.options_max], buffer[stats.buffer_max];
-    option::Parser parse(listUsage, argc, argv, options, buffer);
+    option::Parser parse(eventsUsage, argc, argv, options, buffer);
 
     if (parse.error()) {
         return PARSE_OPTIONS_ERROR;
     }
 
     if (options[HELP]) {
-        option::printUsage(std::cout, listUsage);
+        option::printUsage(std::cout, eventsUsage);
         return 0;
     }
 
@@ -190,36 +1485,45 @@ int aucont_list_main(int argc, char *argv[]) {
         std::cout << "Unknown option: " << opt->name << "\n";
     }
 
-    return aucont_list();
+    events_arguments args;
+    args.throttle_interval_ms = options[THROTTLE_INTERVAL] ?
+                strtol(options[THROTTLE_INTERVAL].arg, nullptr, 10) : 1000;
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_events(args);
 }
 
-const option::Descriptor execUsage[] = {
-    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_exec PID CMD [ARGS]\n\n"
+const option::Descriptor perfUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_perf [options] PID\n"
+                                             "Counts hardware events of container processes on all cpus and "
+                                             "prints cpu usage, throttled periods, IPC, cache miss rate, "
+                                             "cache misses per 1000 instructions and context switches for "
+                                             "every interval\n\n"
                                              "Options:" },
     {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
     {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {INTERVAL, 0, "", "interval", positive, "  --interval MS \treport interval, default is 1000." },
+    {COUNT, 0, "", "count", positive, "  --count N \tstop after N intervals, default is until container exits." },
     {UNKNOWN, 0, "" , "", option::Arg::None,
-        "PID ­ container init process pid in its parent PID namespace\n"
-        "CMD ­ command to run inside container\n"
-        "ARGS ­ arguments for CMD" },
+        "PID ­ container init process pid in its parent PID namespace, container id or name" },
     {0,0,0,0,0,0}
 };
 
-int aucont_exec_main(int argc, char *argv[]) {
+int aucont_perf_main(int argc, char *argv[]) {
     if (argc) {
         argc -= 1;
         argv += 1;
     }
-    option::Stats  stats(execUsage, argc, argv);
+    option::Stats  stats(perfUsage, argc, argv);
     option::Option options[stats.options_max], buffer[stats.buffer_max];
-    option::Parser parse(execUsage, argc, argv, options, buffer);
+    option::Parser parse(perfUsage, argc, argv, options, buffer);
 
     if (parse.error()) {
         return PARSE_OPTIONS_ERROR;
     }
 
-    if (options[HELP] || parse.nonOptionsCount() < 1) {
-        option::printUsage(std::cout, execUsage);
+    if (options[HELP] || parse.nonOptionsCount() != 1) {
+        option::printUsage(std::cout, perfUsage);
         return 0;
     }
 
@@ -227,20 +1531,166 @@ int aucont_exec_main(int argc, char *argv[]) {
         std::cout << "Unknown option: " << opt->name << "\n";
     }
 
-    exec_arguments args;
-    char* endptr = 0;
-    args.pid = strtol(parse.nonOption(0), &endptr, 10);
-    if (endptr == parse.nonOption(0) || *endptr != 0) {
-        print_arg_error_message("PID", "should be numeric\n");
+    perf_arguments args;
+    if (!parse_container_ref(parse.nonOption(0), args.pid)) {
         return PARSE_ARG_ERROR;
     }
-    args.cmd = parse.nonOption(1);
-    args.cmd_args = const_cast<char*const*>(parse.nonOptions() + 1);
-    args.cmd_args_count = parse.nonOptionsCount() - 2;
+    args.interval_ms = options[INTERVAL] ? strtol(options[INTERVAL].arg, nullptr, 10) : 1000;
+    args.count = options[COUNT] ? strtol(options[COUNT].arg, nullptr, 10) : 0;
     args.debug_enabled = options[DEBUG];
 
+    return aucont_perf(args);
+}
 
-    return aucont_exec(args);
+const option::Descriptor daemonUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_daemon [options]\n"
+                                             "Runs until interrupted, every interval grows cpu and memory "
+                                             "limits of containers under pressure and shrinks limits of idle "
+                                             "ones within bounds. Pressure is PSI stall time if cgroup has it, "
+                                             "percent of throttled periods for cpu and hitting the limit for "
+                                             "memory otherwise\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {INTERVAL, 0, "", "interval", positive, "  --interval MS \tcontrol interval, default is 1000." },
+    {SLICE, 0, "", "slice", slice_name, "  --slice NAME \tcontrol only containers of slice." },
+    {STEP, 0, "", "step", percent, "  --step PERCENT \tlargest limit change per interval, default is 20." },
+    {CPU_TARGET, 0, "", "cpu-target", percent, "  --cpu-target PERCENT \tcpu pressure to keep below, "
+                                               "default is 10." },
+    {CPU_MIN, 0, "", "cpu-min", percent, "  --cpu-min CPU_PERCENT \tlowest cpu limit, default is 1." },
+    {CPU_MAX, 0, "", "cpu-max", percent, "  --cpu-max CPU_PERCENT \thighest cpu limit, default is 100." },
+    {MEMORY_TARGET, 0, "", "memory-target", percent, "  --memory-target PERCENT \tmemory pressure to keep "
+                                                     "below, default is 10." },
+    {MEMORY_MIN, 0, "", "memory-min", size, "  --memory-min SIZE \tlowest memory limit, default is 16m." },
+    {MEMORY_MAX, 0, "", "memory-max", size, "  --memory-max SIZE \thighest memory limit, memory limits "
+                                            "are controlled only if it is set." },
+    {RECLAIM_IDLE, 0, "", "reclaim-idle", positive, "  --reclaim-idle SECONDS \treclaim memory of containers "
+                                                    "idle for this long down to memory-min, their soft limit "
+                                                    "is dropped until they are busy or daemon stops." },
+    {RECLAIM_PERCENT, 0, "", "reclaim-percent", percent, "  --reclaim-percent PERCENT \tpercent of idle "
+                                                         "container memory reclaimed per interval, default is 10." },
+    {RECLAIM_ONLY, 0, "", "reclaim-only", option::Arg::None, "  --reclaim-only \tdon't control limits, "
+                                                             "only reclaim memory of idle containers." },
+    {0,0,0,0,0,0}
+};
+
+int aucont_daemon_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(daemonUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(daemonUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP]) {
+        option::printUsage(std::cout, daemonUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    daemon_arguments args;
+    if (options[INTERVAL]) {
+        args.interval_ms = strtol(options[INTERVAL].arg, nullptr, 10);
+    }
+    if (options[SLICE]) {
+        args.slice = options[SLICE].arg;
+    }
+    if (options[STEP]) {
+        args.step_percent = strtol(options[STEP].arg, nullptr, 10);
+    }
+    if (options[CPU_TARGET]) {
+        args.cpu_target = strtol(options[CPU_TARGET].arg, nullptr, 10);
+    }
+    if (options[CPU_MIN]) {
+        args.cpu_min = strtol(options[CPU_MIN].arg, nullptr, 10);
+    }
+    if (options[CPU_MAX]) {
+        args.cpu_max = strtol(options[CPU_MAX].arg, nullptr, 10);
+    }
+    if (options[MEMORY_TARGET]) {
+        args.memory_target = strtol(options[MEMORY_TARGET].arg, nullptr, 10);
+    }
+    if (options[MEMORY_MIN]) {
+        parse_size(options[MEMORY_MIN].arg, args.memory_min);
+    }
+    if (options[MEMORY_MAX]) {
+        parse_size(options[MEMORY_MAX].arg, args.memory_max);
+    }
+    if (options[RECLAIM_IDLE]) {
+        args.reclaim_idle_sec = strtol(options[RECLAIM_IDLE].arg, nullptr, 10);
+    }
+    if (options[RECLAIM_PERCENT]) {
+        args.reclaim_percent = strtol(options[RECLAIM_PERCENT].arg, nullptr, 10);
+    }
+    if (options[RECLAIM_ONLY]) {
+        if (!args.reclaim_idle_sec) {
+            print_arg_error_message("reclaim-only", "requires --reclaim-idle\n");
+            return PARSE_ARG_ERROR;
+        }
+        args.control_limits = false;
+    }
+    if (args.cpu_min > args.cpu_max || args.cpu_min == 0) {
+        print_arg_error_message("cpu-min", "should be positive and not greater than cpu-max\n");
+        return PARSE_ARG_ERROR;
+    }
+    if (args.memory_max && args.memory_min > args.memory_max) {
+        print_arg_error_message("memory-min", "should not be greater than memory-max\n");
+        return PARSE_ARG_ERROR;
+    }
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_daemon(args);
+}
+
+const option::Descriptor logsUsage[] = {
+    {UNKNOWN, 0, "" , "", option::Arg::None, "USAGE: ./aucont_logs [options] ID\n"
+                                             "Prints output of container started with --log, rotated files first\n\n"
+                                             "Options:" },
+    {HELP, 0, "h" , "help", option::Arg::None, "  --help, -h  \tprint usage." },
+    {DEBUG, 0, "" , "debug", option::Arg::None, "  --debug  \tprint debug output." },
+    {FOLLOW, 0, "f", "follow", option::Arg::None, "  --follow, -f  \tprint new output until container exits." },
+    {UNKNOWN, 0, "" , "", option::Arg::None,
+        "ID ­ container id, name or pid. Logs of the last 64 exited containers are kept, "
+        "then only id can be used" },
+    {0,0,0,0,0,0}
+};
+
+int aucont_logs_main(int argc, char *argv[]) {
+    if (argc) {
+        argc -= 1;
+        argv += 1;
+    }
+    option::Stats  stats(logsUsage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(logsUsage, argc, argv, options, buffer);
+
+    if (parse.error()) {
+        return PARSE_OPTIONS_ERROR;
+    }
+
+    if (options[HELP] || parse.nonOptionsCount() != 1) {
+        option::printUsage(std::cout, logsUsage);
+        return 0;
+    }
+
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next()) {
+        std::cout << "Unknown option: " << opt->name << "\n";
+    }
+
+    logs_arguments args;
+    args.id = parse.nonOption(0);
+    args.follow = options[FOLLOW];
+    args.debug_enabled = options[DEBUG];
+
+    return aucont_logs(args);
 }
 
 /***********************************************/
@@ -250,13 +1700,28 @@ static const std::string START_CMD("start");
 static const std::string STOP_CMD("stop");
 static const std::string LIST_CMD("list");
 static const std::string EXEC_CMD("exec");
+static const std::string TEMPLATE_CMD("template");
+static const std::string BENCH_NET_CMD("bench-net");
+static const std::string BENCH_CPU_CMD("bench-cpu");
+static const std::string BENCH_REGISTRY_CMD("bench-registry");
+static const std::string PAUSE_CMD("pause");
+static const std::string RESUME_CMD("resume");
+static const std::string UPDATE_CMD("update");
+static const std::string SLICE_CMD("slice");
+static const std::string EVENTS_CMD("events");
+static const std::string PERF_CMD("perf");
+static const std::string DAEMON_CMD("daemon");
+static const std::string LOGS_CMD("logs");
 /***********************************************/
 
 void print_aucont_usage_string() {
     std::cerr << "usage: aucont cmd cmd_args" << std::endl
               << "where cmd is" << std::endl
               << START_CMD << '|' << STOP_CMD << '|'
-              << LIST_CMD << '|' << EXEC_CMD << std::endl;
+              << LIST_CMD << '|' << EXEC_CMD << '|' << TEMPLATE_CMD << '|'
+              << BENCH_NET_CMD << '|' << BENCH_CPU_CMD << '|' << BENCH_REGISTRY_CMD << '|' << PAUSE_CMD << '|' << RESUME_CMD << '|'
+              << UPDATE_CMD << '|' << SLICE_CMD << '|' << EVENTS_CMD << '|' << PERF_CMD << '|' << DAEMON_CMD << '|'
+              << LOGS_CMD << std::endl;
 }
 
 int main(int argc, char *argv[]) {
@@ -280,6 +1745,42 @@ int main(int argc, char *argv[]) {
     if (cmd == EXEC_CMD) {
         return aucont_exec_main(argc - 1, argv + 1);
     }
+    if (cmd == TEMPLATE_CMD) {
+        return aucont_template_main(argc - 1, argv + 1);
+    }
+    if (cmd == BENCH_NET_CMD) {
+        return aucont_bench_net_main(argc - 1, argv + 1);
+    }
+    if (cmd == UPDATE_CMD) {
+        return aucont_update_main(argc - 1, argv + 1);
+    }
+    if (cmd == SLICE_CMD) {
+        return aucont_slice_main(argc - 1, argv + 1);
+    }
+    if (cmd == EVENTS_CMD) {
+        return aucont_events_main(argc - 1, argv + 1);
+    }
+    if (cmd == PERF_CMD) {
+        return aucont_perf_main(argc - 1, argv + 1);
+    }
+    if (cmd == DAEMON_CMD) {
+        return aucont_daemon_main(argc - 1, argv + 1);
+    }
+    if (cmd == LOGS_CMD) {
+        return aucont_logs_main(argc - 1, argv + 1);
+    }
+    if (cmd == BENCH_CPU_CMD) {
+        return aucont_bench_cpu_main(argc - 1, argv + 1);
+    }
+    if (cmd == BENCH_REGISTRY_CMD) {
+        return aucont_bench_registry_main(argc - 1, argv + 1);
+    }
+    if (cmd == PAUSE_CMD) {
+        return aucont_pause_resume_main(argc - 1, argv + 1, pauseUsage, aucont_pause);
+    }
+    if (cmd == RESUME_CMD) {
+        return aucont_pause_resume_main(argc - 1, argv + 1, resumeUsage, aucont_resume);
+    }
 
     std::cerr << "command \"" << cmd << "\" not found" << std::endl;
     print_aucont_usage_string();
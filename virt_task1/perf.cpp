@@ -0,0 +1,237 @@
+#include "aucont.h"
+#include "cgroups.h"
+#include "error_codes.h"
+#include "registry.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <linux/perf_event.h>
+
+
+// Cycles lead the group: counters of a group are scheduled together, so
+// IPC and miss rates are computed from the same time slices
+enum hw_counter_t {
+    HW_CYCLES,
+    HW_INSTRUCTIONS,
+    HW_CACHE_REFERENCES,
+    HW_CACHE_MISSES,
+    HW_COUNTERS_COUNT
+};
+
+static uint64_t const HW_COUNTER_CONFIGS[HW_COUNTERS_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES
+};
+
+typedef std::chrono::steady_clock perf_clock;
+
+// Counters of container cgroup on one cpu
+struct cpu_counters {
+    int context_switches_fd;
+    int hw_fds[HW_COUNTERS_COUNT]; // -1: not opened, group is read through cycles fd
+};
+
+struct perf_sample {
+    double hw[HW_COUNTERS_COUNT];
+    double context_switches;
+    uint64_t usage_ns; // cpuacct.usage
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+};
+
+static int perf_event_open(uint32_t type, uint64_t config, int cgroup_fd, int cpu, int group_fd) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    if (type == PERF_TYPE_HARDWARE) {
+        attr.read_format |= PERF_FORMAT_GROUP;
+    }
+    return syscall(SYS_perf_event_open, &attr, cgroup_fd, cpu, group_fd, PERF_FLAG_PID_CGROUP | PERF_FLAG_FD_CLOEXEC);
+}
+
+static void close_counters(std::vector<cpu_counters> const &counters) {
+    for (cpu_counters const &cpu_cnt: counters) {
+        close(cpu_cnt.context_switches_fd);
+        for (int fd: cpu_cnt.hw_fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+}
+
+static void check_perf_permission(std::string const &counter) {
+    if (errno == EACCES || errno == EPERM) {
+        std::ifstream paranoid_file("/proc/sys/kernel/perf_event_paranoid");
+        std::string paranoid = "unknown";
+        paranoid_file >> paranoid;
+        throw aucont_exception("Not permitted to open " + counter + " counter: cpu wide counters need "
+                               "kernel.perf_event_paranoid <= 0 (it is " + paranoid + ") or CAP_PERFMON");
+    }
+}
+
+// Offline cpus are skipped, hardware counters are missing in most VMs
+static std::vector<cpu_counters> open_counters(int cgroup_fd, bool debug_enabled) {
+    std::vector<cpu_counters> counters;
+    long const cpus_count = sysconf(_SC_NPROCESSORS_CONF);
+    try {
+        for (int cpu = 0; cpu < cpus_count; ++cpu) {
+            cpu_counters cpu_cnt = {-1, {-1, -1, -1, -1}};
+            cpu_cnt.context_switches_fd = perf_event_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,
+                                                          cgroup_fd, cpu, -1);
+            if (cpu_cnt.context_switches_fd == -1) {
+                check_perf_permission("context switches");
+                check_result(errno == ENODEV ? 0 : -1, "Failed to open context switches counter");
+                continue;
+            }
+            counters.push_back(cpu_cnt);
+
+            cpu_counters &opened = counters.back();
+            for (int counter = 0; counter < HW_COUNTERS_COUNT; ++counter) {
+                opened.hw_fds[counter] = perf_event_open(PERF_TYPE_HARDWARE, HW_COUNTER_CONFIGS[counter], cgroup_fd,
+                                                         cpu, opened.hw_fds[HW_CYCLES]);
+                if (opened.hw_fds[HW_CYCLES] == -1) {
+                    break; // no group, no hardware counters
+                }
+            }
+            if (debug_enabled && opened.hw_fds[HW_CYCLES] == -1) {
+                printDebug() << "Hardware counters aren't available on cpu " << cpu << std::endl;
+            }
+        }
+    } catch(...) {
+        close_counters(counters);
+        throw;
+    }
+    return counters;
+}
+
+// Counts are scaled by enabled/running time: counters are multiplexed if
+// there are more of them than the PMU has
+static double scaled(uint64_t value, uint64_t enabled, uint64_t running) {
+    return running ? static_cast<double>(value) * enabled / running : 0;
+}
+
+static perf_sample read_sample(std::vector<cpu_counters> const &counters, std::string const &cpu_dir,
+                               std::string const &cpuacct_dir) {
+    perf_sample sample = {};
+    for (cpu_counters const &cpu_cnt: counters) {
+        uint64_t single[3]; // value, time enabled, time running
+        if (read(cpu_cnt.context_switches_fd, single, sizeof(single)) == sizeof(single)) {
+            sample.context_switches += scaled(single[0], single[1], single[2]);
+        }
+        if (cpu_cnt.hw_fds[HW_CYCLES] == -1) {
+            continue;
+        }
+        uint64_t group[3 + HW_COUNTERS_COUNT]; // nr, time enabled, time running, values in opening order
+        if (read(cpu_cnt.hw_fds[HW_CYCLES], group, sizeof(group)) == -1) {
+            continue;
+        }
+        int position = 0;
+        for (int counter = 0; counter < HW_COUNTERS_COUNT; ++counter) {
+            if (cpu_cnt.hw_fds[counter] != -1) {
+                sample.hw[counter] += scaled(group[3 + position++], group[1], group[2]);
+            }
+        }
+    }
+    sample.usage_ns = std::stoull(read_cgroup_value(cpuacct_dir, "cpuacct.usage"));
+    std::ifstream stat(cpu_dir + "/cpu.stat");
+    std::string key;
+    uint64_t value;
+    while (stat >> key >> value) {
+        if (key == "nr_periods") {
+            sample.nr_periods = value;
+        } else if (key == "nr_throttled") {
+            sample.nr_throttled = value;
+        }
+    }
+    return sample;
+}
+
+static void print_header(bool hw_available) {
+    std::cout << "cpus\tthrottled%";
+    if (hw_available) {
+        std::cout << "\tGHz\tIPC\tcache-miss%\tMPKI";
+    }
+    std::cout << "\tctx-switches/s" << std::endl;
+}
+
+// cpus and throttling tell CPU starvation, IPC and cache misses tell thrashing
+static void print_interval(perf_sample const &from, perf_sample const &to, double seconds, bool hw_available) {
+    double const cpu_seconds = (to.usage_ns - from.usage_ns) / 1e9;
+    uint64_t const periods = to.nr_periods - from.nr_periods;
+    double hw[HW_COUNTERS_COUNT];
+    for (int counter = 0; counter < HW_COUNTERS_COUNT; ++counter) {
+        hw[counter] = to.hw[counter] - from.hw[counter];
+    }
+    std::cout << std::fixed << std::setprecision(2) << cpu_seconds / seconds << '\t'
+              << (periods ? 100.0 * (to.nr_throttled - from.nr_throttled) / periods : 0);
+    if (hw_available) {
+        std::cout << '\t' << (cpu_seconds > 0 ? hw[HW_CYCLES] / cpu_seconds / 1e9 : 0)
+                  << '\t' << (hw[HW_CYCLES] > 0 ? hw[HW_INSTRUCTIONS] / hw[HW_CYCLES] : 0)
+                  << '\t' << (hw[HW_CACHE_REFERENCES] > 0 ? 100 * hw[HW_CACHE_MISSES] / hw[HW_CACHE_REFERENCES] : 0)
+                  << '\t' << (hw[HW_INSTRUCTIONS] > 0 ? 1000 * hw[HW_CACHE_MISSES] / hw[HW_INSTRUCTIONS] : 0);
+    }
+    std::cout << '\t' << std::setprecision(0) << (to.context_switches - from.context_switches) / seconds
+              << std::endl;
+}
+
+int aucont_perf(perf_arguments const &args) {
+    int cgroup_fd = -1;
+    std::vector<cpu_counters> counters;
+    try {
+        container_record record = {};
+        container_registry().find_by_pid(args.pid, record);
+        if (!process_alive(args.pid, record.proc_start_time)) {
+            throw aucont_exception("Process with pid " + std::to_string(args.pid) + " is not running atm");
+        }
+        std::string const perf_dir = container_cgroup_dir(PERF_EVENT_CGROUP_DIR, args.pid);
+        std::string const cpu_dir = container_cgroup_dir(CPU_CGROUP_DIR, args.pid);
+        std::string const cpuacct_dir = container_cgroup_dir(CPUACCT_CGROUP_DIR, args.pid);
+        if (args.debug_enabled) {
+            printDebug() << "perf_event cgroup is " << perf_dir << std::endl;
+        }
+        cgroup_fd = check_result(open(perf_dir.c_str(), O_RDONLY | O_CLOEXEC), "Failed to open " + perf_dir);
+        counters = open_counters(cgroup_fd, args.debug_enabled);
+        bool hw_available = false;
+        for (cpu_counters const &cpu_cnt: counters) {
+            hw_available = hw_available || cpu_cnt.hw_fds[HW_CYCLES] != -1;
+        }
+        if (!hw_available) {
+            std::cout << "Hardware counters aren't available, only software ones are reported" << std::endl;
+        }
+
+        print_header(hw_available);
+        perf_sample last = read_sample(counters, cpu_dir, cpuacct_dir);
+        auto last_time = perf_clock::now();
+        for (int interval = 0; args.count == 0 || interval < args.count; ++interval) {
+            usleep(args.interval_ms * 1000);
+            if (!process_alive(args.pid, record.proc_start_time)) {
+                break;
+            }
+            perf_sample const sample = read_sample(counters, cpu_dir, cpuacct_dir);
+            auto const now = perf_clock::now();
+            print_interval(last, sample, std::chrono::duration<double>(now - last_time).count(), hw_available);
+            last = sample;
+            last_time = now;
+        }
+
+        close_counters(counters);
+        close(cgroup_fd);
+        return 0;
+    } catch(std::exception &e) {
+        close_counters(counters);
+        if (cgroup_fd != -1) {
+            close(cgroup_fd);
+        }
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
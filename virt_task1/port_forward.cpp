@@ -0,0 +1,269 @@
+#include "port_forward.h"
+#include "utils.h"
+#include <iostream>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <syscall.h>
+
+
+static size_t const SPLICE_CHUNK = 1 << 16; // 64kb, default pipe capacity
+static int const MAX_EVENTS = 64;
+static int const NO_PIDFD_POLL_MS = 1000;
+
+port_forwarder::port_forwarder(in_addr_t cont_ip, std::vector<publish_spec> const &publish,
+                               bool debug_enabled):
+    cont_ip(cont_ip),
+    debug_enabled(debug_enabled),
+    epoll_fd(check_result(epoll_create1(EPOLL_CLOEXEC), "Failed to create epoll"))
+{
+    try {
+        for (publish_spec const &spec: publish) {
+            std::unique_ptr<endpoint> listener(new endpoint());
+            listener->type = LISTENER;
+            listener->conn = nullptr;
+            listener->cont_port = spec.cont_port;
+            listener->fd = check_result(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0),
+                                        "Failed to create listen socket");
+            listeners.push_back(std::move(listener));
+
+            int const fd = listeners.back()->fd;
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            addr.sin_port = htons(spec.host_port);
+            check_result(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)),
+                         "Failed to bind host port " + std::to_string(spec.host_port));
+            check_result(listen(fd, SOMAXCONN), "Failed to listen host port " + std::to_string(spec.host_port));
+            add_to_epoll(*listeners.back(), EPOLLIN);
+        }
+    } catch(...) {
+        for (auto &listener: listeners) {
+            close(listener->fd);
+        }
+        close(epoll_fd);
+        throw;
+    }
+}
+
+port_forwarder::~port_forwarder() {
+    for (auto &conn: connections) {
+        close_connection(*conn);
+    }
+    for (auto &listener: listeners) {
+        close(listener->fd);
+    }
+    close(epoll_fd);
+}
+
+void port_forwarder::add_to_epoll(endpoint &ep, unsigned int events) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.ptr = &ep;
+    check_result(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ep.fd, &event), "Failed to add fd to epoll");
+}
+
+void port_forwarder::set_connection_hook(std::function<void()> const &hook) {
+    connection_hook = hook;
+}
+
+void port_forwarder::run(int pid) {
+    signal(SIGPIPE, SIG_IGN); // peers closing sockets are handled by EPIPE
+
+    endpoint container_exit = {CONTAINER_EXIT, -1, nullptr, 0};
+    bool container_exited = false;
+#ifdef SYS_pidfd_open
+    container_exit.fd = syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+#endif
+    if (container_exit.fd != -1) {
+        add_to_epoll(container_exit, EPOLLIN);
+    } else if (errno == ESRCH) {
+        container_exited = true;
+    } else if (errno == ENOSYS) {
+        if (debug_enabled) {
+            printDebug() << "pidfd is not supported, polling container state" << std::endl;
+        }
+    } else {
+        check_result(container_exit.fd, "Failed to open pidfd of container " + std::to_string(pid));
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (!container_exited) {
+        int const timeout = container_exit.fd == -1 ? NO_PIDFD_POLL_MS : -1;
+        int const ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(ready, "epoll_wait failed");
+        if (container_exit.fd == -1 && !process_exist(pid)) {
+            break;
+        }
+
+        for (int event_idx = 0; event_idx < ready; ++event_idx) {
+            endpoint &ep = *reinterpret_cast<endpoint*>(events[event_idx].data.ptr);
+            switch (ep.type) {
+            case LISTENER:
+                accept_connections(ep);
+                break;
+            case CLIENT:
+            case UPSTREAM:
+                if (!ep.conn->closed) {
+                    handle_connection(*ep.conn, ep, events[event_idx].events);
+                }
+                break;
+            case CONTAINER_EXIT:
+                container_exited = true;
+                break;
+            }
+        }
+
+        // Connections are freed after the batch: later events may point to them
+        for (auto conn_it = connections.begin(); conn_it != connections.end();) {
+            if ((*conn_it)->closed) {
+                conn_it = connections.erase(conn_it);
+            } else {
+                ++conn_it;
+            }
+        }
+    }
+
+    if (container_exit.fd != -1) {
+        close(container_exit.fd);
+    }
+    if (debug_enabled) {
+        printDebug() << "Container exited, port forwarding stopped" << std::endl;
+    }
+}
+
+void port_forwarder::accept_connections(endpoint &listener) {
+    while (true) {
+        int client_fd = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && debug_enabled) {
+                printDebug() << "accept failed. Errno = " << errno << std::endl;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        if (connection_hook) {
+            connection_hook();
+        }
+        int upstream_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = cont_ip;
+        addr.sin_port = htons(listener.cont_port);
+        if (upstream_fd == -1 ||
+                (connect(upstream_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 &&
+                 errno != EINPROGRESS)) {
+            if (debug_enabled) {
+                printDebug() << "Failed to connect to container port " << listener.cont_port << std::endl;
+            }
+            close(client_fd);
+            if (upstream_fd != -1) {
+                close(upstream_fd);
+            }
+            continue;
+        }
+
+        std::unique_ptr<connection> conn(new connection());
+        conn->client = {CLIENT, client_fd, conn.get(), 0};
+        conn->upstream = {UPSTREAM, upstream_fd, conn.get(), 0};
+        conn->dirs[0] = {client_fd, upstream_fd, {-1, -1}, 0, false};
+        conn->dirs[1] = {upstream_fd, client_fd, {-1, -1}, 0, false};
+        conn->connected = false;
+        conn->closed = false;
+        connections.push_back(std::move(conn));
+        connection &added = *connections.back();
+        try {
+            for (direction &dir: added.dirs) {
+                check_result(pipe2(dir.pipe_fds, O_NONBLOCK | O_CLOEXEC), "Failed to create splice pipe");
+            }
+            // Edge triggered: every event pumps both directions until EAGAIN
+            add_to_epoll(added.client, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            add_to_epoll(added.upstream, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        } catch(std::exception &e) {
+            if (debug_enabled) {
+                printDebug() << e.what() << std::endl;
+            }
+            close_connection(added);
+        }
+    }
+}
+
+void port_forwarder::handle_connection(connection &conn, endpoint &ep, unsigned int events) {
+    if (ep.type == UPSTREAM && !conn.connected) {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        getsockopt(conn.upstream.fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+        if (error != 0 || (events & EPOLLERR)) {
+            close_connection(conn);
+            return;
+        }
+        conn.connected = true;
+    }
+    if (!conn.connected) {
+        return; // client data waits in socket buffer until upstream is connected
+    }
+
+    if (!pump(conn.dirs[0]) || !pump(conn.dirs[1]) ||
+            (conn.dirs[0].eof && conn.dirs[1].eof)) {
+        close_connection(conn);
+    }
+}
+
+bool port_forwarder::pump(direction &dir) {
+    while (true) {
+        if (dir.in_pipe != 0) {
+            ssize_t moved = splice(dir.pipe_fds[0], nullptr, dir.to, nullptr, dir.in_pipe,
+                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved == -1) {
+                return errno == EAGAIN || errno == EINTR; // wait for EPOLLOUT on 'to'
+            }
+            dir.in_pipe -= moved;
+            continue;
+        }
+        if (dir.eof) {
+            return true;
+        }
+        ssize_t moved = splice(dir.from, nullptr, dir.pipe_fds[1], nullptr, SPLICE_CHUNK,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved == -1) {
+            return errno == EAGAIN || errno == EINTR; // wait for EPOLLIN on 'from'
+        }
+        if (moved == 0) {
+            dir.eof = true;
+            shutdown(dir.to, SHUT_WR);
+            return true;
+        }
+        dir.in_pipe += moved;
+    }
+}
+
+void port_forwarder::close_connection(connection &conn) {
+    if (conn.closed) {
+        return;
+    }
+    conn.closed = true;
+    // closing fds removes them from epoll
+    close(conn.client.fd);
+    close(conn.upstream.fd);
+    for (direction &dir: conn.dirs) {
+        for (int fd: dir.pipe_fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+}
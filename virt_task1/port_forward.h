@@ -0,0 +1,82 @@
+#ifndef PORT_FORWARD_H
+#define PORT_FORWARD_H
+#include <netinet/in.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+struct publish_spec {
+    unsigned short host_port;
+    unsigned short cont_port;
+};
+
+// Forwards TCP connections from host ports to container ports.
+// Bytes are moved between sockets with splice() through a pipe per
+// direction, so they are never copied to userspace.
+class port_forwarder {
+public:
+    // Binds and listens all host ports. Throws aucont_exception on failure
+    port_forwarder(in_addr_t cont_ip, std::vector<publish_spec> const &publish, bool debug_enabled);
+    ~port_forwarder();
+
+    // Runs epoll event loop until container with pid exits
+    void run(int pid);
+
+    // Called for every accepted connection before container port is connected
+    void set_connection_hook(std::function<void()> const &hook);
+
+private:
+    struct connection;
+
+    enum endpoint_type {
+        LISTENER,
+        CLIENT,
+        UPSTREAM,
+        CONTAINER_EXIT
+    };
+
+    struct endpoint {
+        endpoint_type type;
+        int fd;
+        connection *conn;
+        unsigned short cont_port; // for LISTENER only
+    };
+
+    // One direction of forwarded connection: from -> pipe -> to
+    struct direction {
+        int from;
+        int to;
+        int pipe_fds[2];
+        size_t in_pipe;
+        bool eof;
+    };
+
+    struct connection {
+        endpoint client;
+        endpoint upstream;
+        direction dirs[2];
+        bool connected;
+        bool closed;
+    };
+
+    port_forwarder(port_forwarder const &) = delete;
+    port_forwarder& operator=(port_forwarder const &) = delete;
+
+    void accept_connections(endpoint &listener);
+    void handle_connection(connection &conn, endpoint &ep, unsigned int events);
+    // Returns false if direction failed and connection should be closed
+    bool pump(direction &dir);
+    void close_connection(connection &conn);
+    void add_to_epoll(endpoint &ep, unsigned int events);
+
+private:
+    in_addr_t cont_ip;
+    bool debug_enabled;
+    int epoll_fd;
+    std::vector<std::unique_ptr<endpoint>> listeners;
+    std::list<std::unique_ptr<connection>> connections;
+    std::function<void()> connection_hook;
+};
+
+#endif // PORT_FORWARD_H
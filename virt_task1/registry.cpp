@@ -0,0 +1,256 @@
+#include "registry.h"
+#include "utils.h"
+#include <chrono>
+#include <unordered_map>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+
+std::string const container_registry::DEFAULT_FILE_NAME = "/tmp/aucont/registry";
+
+static char const REGISTRY_MAGIC[8] = {'A', 'U', 'C', 'O', 'N', 'T', 'R', '2'};
+
+struct container_registry::header {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t records_count;
+    uint64_t generation; // incremented by every change
+    uint64_t records_offset; // of the array, right after header or past previous array
+
+    size_t records_end() const {
+        return records_offset + records_count * sizeof(container_record);
+    }
+};
+
+class container_registry::file_lock {
+public:
+    file_lock(int fd, int operation, uint64_t &wait_ns):
+        fd(fd)
+    {
+        auto const started = std::chrono::steady_clock::now();
+        while (flock(fd, operation) == -1) {
+            check_result(errno == EINTR ? 0 : -1, "Failed to lock registry");
+        }
+        wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                        started).count();
+    }
+
+    ~file_lock() {
+        flock(fd, LOCK_UN);
+    }
+
+private:
+    int fd;
+};
+
+static void pread_all(int fd, void *data, size_t size, off_t offset) {
+    ssize_t const was_read = pread(fd, data, size, offset);
+    check_result(static_cast<size_t>(was_read) == size ? 0 : -1, "Failed to read registry");
+}
+
+static void pwrite_all(int fd, void const *data, size_t size, off_t offset) {
+    ssize_t const written = pwrite(fd, data, size, offset);
+    check_result(static_cast<size_t>(written) == size ? 0 : -1, "Failed to write registry");
+}
+
+container_registry::container_registry(std::string const &file_name):
+    wait_ns(0)
+{
+    std::string const dir = file_name.substr(0, file_name.rfind('/'));
+    if (!dir.empty()) {
+        mkdir(dir.c_str(), 0777);
+    }
+    fd = check_result(open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666), "Failed to open registry");
+}
+
+container_registry::~container_registry() {
+    close(fd);
+}
+
+uint64_t container_registry::lock_wait_ns() const {
+    return wait_ns;
+}
+
+// Empty file is empty registry
+container_registry::header container_registry::read_header_unsafe() {
+    header hdr = {};
+    struct stat file_stat;
+    check_result(fstat(fd, &file_stat), "Failed to stat registry");
+    if (file_stat.st_size == 0) {
+        memcpy(hdr.magic, REGISTRY_MAGIC, sizeof(hdr.magic));
+        hdr.record_size = sizeof(container_record);
+        hdr.records_offset = sizeof(hdr);
+        return hdr;
+    }
+    if (static_cast<size_t>(file_stat.st_size) < sizeof(hdr)) {
+        throw aucont_exception("Invalid registry file");
+    }
+    pread_all(fd, &hdr, sizeof(hdr), 0);
+    if (memcmp(hdr.magic, REGISTRY_MAGIC, sizeof(hdr.magic)) != 0 || hdr.record_size != sizeof(container_record) ||
+            hdr.records_offset < sizeof(hdr) || static_cast<size_t>(file_stat.st_size) < hdr.records_end()) {
+        throw aucont_exception("Invalid registry file");
+    }
+    return hdr;
+}
+
+container_registry::header container_registry::read_header_exclusive_unsafe() {
+    header const hdr = read_header_unsafe();
+    struct stat file_stat;
+    check_result(fstat(fd, &file_stat), "Failed to stat registry");
+    if (file_stat.st_size != 0 && static_cast<size_t>(file_stat.st_size) != hdr.records_end()) {
+        check_result(ftruncate(fd, hdr.records_end()), "Failed to truncate registry");
+    }
+    return hdr;
+}
+
+void container_registry::write_header_unsafe(header const &hdr) {
+    pwrite_all(fd, &hdr, sizeof(hdr), 0);
+}
+
+std::vector<container_record> container_registry::read_records_unsafe(header const &hdr) {
+    std::vector<container_record> result(hdr.records_count);
+    if (!result.empty()) {
+        pread_all(fd, result.data(), result.size() * sizeof(container_record), hdr.records_offset);
+    }
+    return result;
+}
+
+// New array goes right after header if it fits before the current one,
+// otherwise past the current one. Current array is intact until header
+// points to the new one, so writer may be killed at any moment.
+void container_registry::replace_records_unsafe(header &hdr, std::vector<container_record> const &records) {
+    size_t const size = records.size() * sizeof(container_record);
+    size_t offset = sizeof(header);
+    if (!records.empty() && offset + size > hdr.records_offset) {
+        offset = hdr.records_end();
+    }
+    if (!records.empty()) {
+        pwrite_all(fd, records.data(), size, offset);
+    }
+    hdr.records_offset = offset;
+    hdr.records_count = records.size();
+    hdr.generation += 1;
+    write_header_unsafe(hdr);
+    check_result(ftruncate(fd, hdr.records_end()), "Failed to truncate registry");
+}
+
+void container_registry::add(container_record const &record) {
+    file_lock lock(fd, LOCK_EX, wait_ns);
+    header hdr = read_header_exclusive_unsafe();
+    for (container_record const &registered: read_records_unsafe(hdr)) {
+        if (strcmp(registered.id, record.id) == 0) {
+            throw aucont_exception("Container id " + std::string(record.id) + " is already registered");
+        }
+        if (record.name[0] && strcmp(registered.name, record.name) == 0) {
+            throw aucont_exception("Container name " + std::string(record.name) + " is already used");
+        }
+    }
+    pwrite_all(fd, &record, sizeof(record), hdr.records_end());
+    hdr.records_count += 1;
+    hdr.generation += 1;
+    write_header_unsafe(hdr);
+}
+
+bool container_registry::remove_by_pid(int pid) {
+    file_lock lock(fd, LOCK_EX, wait_ns);
+    header hdr = read_header_exclusive_unsafe();
+    std::vector<container_record> kept = read_records_unsafe(hdr);
+    auto const found = std::find_if(kept.begin(), kept.end(), [pid](container_record const &record) {
+        return record.pid == pid;
+    });
+    if (found == kept.end()) {
+        return false;
+    }
+    kept.erase(found);
+    replace_records_unsafe(hdr, kept);
+    return true;
+}
+
+bool container_registry::update(container_record const &record) {
+    file_lock lock(fd, LOCK_EX, wait_ns);
+    header hdr = read_header_exclusive_unsafe();
+    std::vector<container_record> const registered = read_records_unsafe(hdr);
+    for (size_t pos = 0; pos < registered.size(); ++pos) {
+        if (registered[pos].pid == record.pid && strcmp(registered[pos].id, record.id) == 0) {
+            pwrite_all(fd, &record, sizeof(record), hdr.records_offset + pos * sizeof(container_record));
+            hdr.generation += 1;
+            write_header_unsafe(hdr);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool container_registry::update_limits(container_record &record, int cpu_limit, uint64_t memory_limit) {
+    file_lock lock(fd, LOCK_EX, wait_ns);
+    header hdr = read_header_exclusive_unsafe();
+    std::vector<container_record> const registered = read_records_unsafe(hdr);
+    for (size_t pos = 0; pos < registered.size(); ++pos) {
+        if (registered[pos].pid == record.pid && strcmp(registered[pos].id, record.id) == 0) {
+            record = registered[pos];
+            record.cpu_limit = cpu_limit != -1 ? cpu_limit : record.cpu_limit;
+            record.memory_limit = memory_limit ? memory_limit : record.memory_limit;
+            pwrite_all(fd, &record, sizeof(record), hdr.records_offset + pos * sizeof(container_record));
+            hdr.generation += 1;
+            write_header_unsafe(hdr);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t container_registry::remove_records(std::vector<container_record> const &removed) {
+    if (removed.empty()) {
+        return 0;
+    }
+    std::unordered_map<std::string, int> removed_pids;
+    for (container_record const &record: removed) {
+        removed_pids[record.id] = record.pid;
+    }
+
+    file_lock lock(fd, LOCK_EX, wait_ns);
+    header hdr = read_header_exclusive_unsafe();
+    std::vector<container_record> kept = read_records_unsafe(hdr);
+    size_t const count_before = kept.size();
+    kept.erase(std::remove_if(kept.begin(), kept.end(), [&removed_pids](container_record const &record) {
+        auto const found = removed_pids.find(record.id);
+        return found != removed_pids.end() && found->second == record.pid;
+    }), kept.end());
+    if (kept.size() == count_before) {
+        return 0;
+    }
+    replace_records_unsafe(hdr, kept);
+    return count_before - kept.size();
+}
+
+std::vector<container_record> container_registry::records() {
+    file_lock lock(fd, LOCK_SH, wait_ns);
+    return read_records_unsafe(read_header_unsafe());
+}
+
+template <typename Predicate>
+bool container_registry::find(Predicate const &matches, container_record &record) {
+    for (container_record const &registered: records()) {
+        if (matches(registered)) {
+            record = registered;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool container_registry::find_by_id(std::string const &id, container_record &record) {
+    return find([&id](container_record const &registered) { return id == registered.id; }, record);
+}
+
+bool container_registry::find_by_name(std::string const &name, container_record &record) {
+    return !name.empty() &&
+            find([&name](container_record const &registered) { return name == registered.name; }, record);
+}
+
+bool container_registry::find_by_pid(int pid, container_record &record) {
+    return find([pid](container_record const &registered) { return registered.pid == pid; }, record);
+}
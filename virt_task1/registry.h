@@ -0,0 +1,85 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Fixed size record of started container
+struct container_record {
+    char id[16]; // 12 hex digits, stable while container is registered
+    char name[64]; // empty - unnamed
+    int32_t pid;
+    uint64_t proc_start_time; // starttime from /proc/PID/stat, detects pid reuse
+    int64_t start_time; // unix time
+    int32_t cpu_limit; // percent
+    uint64_t memory_limit; // bytes, 0 - unlimited
+    uint32_t cont_ip; // network byte order, 0 - no network
+    char image[256];
+    char cmd[512];
+    char cgroup[128]; // container cgroup relative to hierarchy root
+};
+
+// Copies value to record string field, truncates it if needed
+template <size_t N>
+void set_record_field(char (&field)[N], std::string const &value) {
+    size_t const size = std::min(value.size(), N - 1);
+    value.copy(field, size);
+    field[size] = 0;
+}
+
+// Registry of started containers: header and array of container_record in
+// one file guarded by flock, so lock of killed process is released.
+// Header points to the array, and a change becomes visible only with header
+// write: added record is written past the array end, array without removed
+// records is written aside of the current one. Writer killed before header
+// write leaves unused bytes, they are trimmed by next change.
+class container_registry {
+public:
+    static std::string const DEFAULT_FILE_NAME;
+
+    explicit container_registry(std::string const &file_name = DEFAULT_FILE_NAME);
+    ~container_registry();
+
+    // Throws aucont_exception if id or name is already registered
+    void add(container_record const &record);
+    bool remove_by_pid(int pid);
+    // Removes records matching both id and pid of given ones under one lock.
+    // Returns number of removed records. Both removals keep order of the rest.
+    size_t remove_records(std::vector<container_record> const &removed);
+    // Replaces record with the same id and pid, false if there is none
+    bool update(container_record const &record);
+    // Sets limits of record registered with the same id and pid and reads it
+    // back, the rest of the fields is kept as registered. cpu_limit -1 and
+    // memory_limit 0 are unchanged. False if there is no such record.
+    bool update_limits(container_record &record, int cpu_limit, uint64_t memory_limit);
+    // All records read under one lock
+    std::vector<container_record> records();
+
+    // Lookups scan all records
+    bool find_by_id(std::string const &id, container_record &record);
+    bool find_by_name(std::string const &name, container_record &record);
+    bool find_by_pid(int pid, container_record &record);
+
+    // Total time spent waiting for the lock by this object
+    uint64_t lock_wait_ns() const;
+
+private:
+    class file_lock;
+    struct header;
+
+    header read_header_unsafe();
+    // Under exclusive lock: also trims bytes left by interrupted change
+    header read_header_exclusive_unsafe();
+    void write_header_unsafe(header const &hdr);
+    std::vector<container_record> read_records_unsafe(header const &hdr);
+    void replace_records_unsafe(header &hdr, std::vector<container_record> const &records);
+    template <typename Predicate>
+    bool find(Predicate const &matches, container_record &record);
+
+private:
+    int fd;
+    uint64_t wait_ns;
+};
+
+#endif // REGISTRY_H
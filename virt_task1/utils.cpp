@@ -0,0 +1,165 @@
+#include "utils.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <poll.h>
+#include <syscall.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+
+// Checks if check_return_code(return_code)
+// Throws aucont_exception if !check_return_code(return_code) with 'exception_message'
+// Returns return_code
+int check_result(int return_code, std::string const &exception_message,
+                 bool (*check_return_code)(int)) {
+    if (!check_return_code(return_code)) {
+        throw(aucont_exception(exception_message));
+    }
+    return return_code;
+}
+
+void exec_check_result(std::string const &command) {
+    check_result(system(command.c_str()),
+                 "command '" + command + "' execution failed",
+                 [](int code) {return code == 0;});
+}
+
+std::ostream& printDebug() {
+    return std::cout << "Debug: ";
+}
+
+std::string to_string(in_addr_t ip) {
+    char buffer[INET_ADDRSTRLEN + 1];
+    inet_ntop(AF_INET, &ip, buffer, INET_ADDRSTRLEN);
+    return buffer;
+}
+
+bool process_exist(int pid) {
+    // from man kill
+    // If sig is 0, then no signal is sent,
+    // but error checking is still performed;
+    // this can be used to check for the
+    // existence of a process ID or process group ID.
+    return kill(pid, 0) == 0;
+}
+
+void set_ns(std::string const &pid_str, std::string const &ns_name) {
+    std::string ns_dir_path_str = "/proc/" + pid_str + "/ns/" + ns_name;
+    int ns_dir = check_result(open(ns_dir_path_str.c_str(), O_RDONLY, O_CLOEXEC), "Failed to open ns dir");
+    check_result(setns(ns_dir, 0), "Failed to set ns");
+    check_result(close(ns_dir), "Failed to close ns dir descriptor");
+}
+
+double percentile(std::vector<double> const &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+unsigned long long process_start_time(int pid) {
+    std::ifstream stat_file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    if (!std::getline(stat_file, stat)) {
+        return 0;
+    }
+    // comm may contain spaces and parentheses, fields after it are numbers
+    std::istringstream fields(stat.substr(stat.rfind(')') + 1));
+    static int const STARTTIME_FIELD = 22;
+    static int const FIRST_FIELD_AFTER_COMM = 3;
+    std::string field;
+    for (int field_idx = FIRST_FIELD_AFTER_COMM; field_idx < STARTTIME_FIELD; ++field_idx) {
+        fields >> field;
+    }
+    unsigned long long start_time = 0;
+    fields >> start_time;
+    return start_time;
+}
+
+bool process_alive(int pid, unsigned long long start_time) {
+#ifdef SYS_pidfd_open
+    int const pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1 && errno == ESRCH) {
+        return false;
+    }
+    if (pidfd != -1) {
+        // pidfd pins the process: start time read after open is its own
+        bool alive = start_time == 0 || process_start_time(pid) == start_time;
+        pollfd exited = {pidfd, POLLIN, 0}; // readable pidfd - process exited
+        alive = alive && poll(&exited, 1, 0) == 0;
+        close(pidfd);
+        return alive;
+    }
+#endif
+    return process_exist(pid) && (start_time == 0 || process_start_time(pid) == start_time);
+}
+
+std::string json_escape(std::string const &str) {
+    std::string escaped;
+    for (char c: str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void make_dirs(std::string const &path, mode_t mode) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string const dir = path.substr(0, slash);
+        if (!dir.empty() && mkdir(dir.c_str(), mode) == -1 && errno != EEXIST) {
+            throw aucont_exception("Failed to make dir " + dir);
+        }
+        if (slash == std::string::npos) {
+            return;
+        }
+    }
+}
+
+void copy_fd(int from_fd, int to_fd) {
+    static size_t const CHUNK = 1 << 20;
+    for (;;) {
+        ssize_t const sent = sendfile(to_fd, from_fd, nullptr, CHUNK);
+        if (sent == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            break;
+        }
+        if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(sent, "Failed to copy fd");
+        if (sent == 0) {
+            return;
+        }
+    }
+    char buffer[1 << 16];
+    ssize_t got;
+    while ((got = read(from_fd, buffer, sizeof(buffer))) != 0) {
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        check_result(got, "Failed to copy fd");
+        for (ssize_t written = 0; written < got;) {
+            ssize_t const result = write(to_fd, buffer + written, got - written);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            written += check_result(result, "Failed to copy fd");
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef UTILS_H
+#define UTILS_H
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <exception>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+class aucont_exception: public std::exception
+{
+public:
+    aucont_exception(std::string const &what_str):
+        what_str(what_str)
+    {
+    }
+
+    const char* what() const throw()
+    {
+        return what_str.c_str();
+    }
+
+private:
+    std::string what_str;
+};
+
+// Checks if check_return_code(return_code)
+// Throws aucont_exception if !check_return_code(return_code) with 'exception_message'
+// Returns return_code
+int check_result(int return_code, std::string const &exception_message,
+                 bool (*check_return_code)(int) = [](int code){return code != -1;});
+
+// Executes shell command, throws aucont_exception if it fails
+void exec_check_result(std::string const &command);
+
+std::ostream& printDebug();
+
+std::string to_string(in_addr_t ip);
+
+bool process_exist(int pid);
+
+// Enters ns_name namespace of process pid_str
+void set_ns(std::string const &pid_str, std::string const &ns_name);
+
+// starttime field of /proc/PID/stat (clock ticks after boot), 0 if process
+// doesn't exist. Together with pid it identifies process.
+unsigned long long process_start_time(int pid);
+
+// Checks process through pidfd: process with start_time (0 - any) is alive
+// and isn't a zombie. Reused pid isn't mistaken for the process.
+bool process_alive(int pid, unsigned long long start_time);
+
+// Copies from current position of from_fd to its end with sendfile, or with
+// read/write if to_fd can't take it (e.g. O_APPEND file). Throws on failure.
+void copy_fd(int from_fd, int to_fd);
+
+// Creates dir and its missing parents like mkdir -p, throws on failure
+void make_dirs(std::string const &path, mode_t mode = 0777);
+
+// Escapes string for JSON string literal (without quotes)
+std::string json_escape(std::string const &str);
+
+// p-th percentile (0..100) of sorted values, 0 if empty
+double percentile(std::vector<double> const &sorted, double p);
+
+
+#endif // UTILS_H
@@ -0,0 +1,365 @@
+#include "zygote.h"
+#include "aucont.h"
+#include "error_codes.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <syscall.h>
+#include <sched.h>
+#include <wait.h>
+#include <dlfcn.h>
+
+
+static std::string const TEMPLATES_DIR = "/tmp/aucont/templates";
+static size_t const MAX_REQUEST_SIZE = 1 << 16;
+static int const STDIO_FDS_COUNT = 3;
+
+typedef int (*entry_function)(int argc, char *argv[]);
+
+// Request is sent as one SOCK_SEQPACKET message with stdio fds attached:
+// header, cmd '\0' arg0 '\0' arg1 '\0' ...
+struct request_header {
+    uint32_t daemonize;
+    uint32_t args_count;
+};
+
+static std::string socket_path(std::string const &name) {
+    return TEMPLATES_DIR + "/" + name + ".sock";
+}
+
+static std::string pid_file_path(std::string const &name) {
+    return TEMPLATES_DIR + "/" + name + ".pid";
+}
+
+static sockaddr_un make_addr(std::string const &path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    check_result(path.size() < sizeof(addr.sun_path), "Too long socket path " + path,
+                 [](int ok) { return ok != 0; });
+    path.copy(addr.sun_path, path.size());
+    return addr;
+}
+
+/*Zygote side**********************************/
+
+// Runs in container process forked by zygote, after new namespaces were unshared.
+// Mounts own proc, tmp and sys over zygote's ones and execs command, or calls
+// entry with it, keeping memory of preloaded libraries shared with zygote.
+static void container_from_template(int conn, std::vector<std::string> const &argv,
+                                    int const stdio_fds[STDIO_FDS_COUNT], bool daemonize, entry_function entry) {
+    char go = 0;
+    if (recv(conn, &go, 1, 0) != 1 || go != 'g') {
+        _exit(GO_COMMAND_ERROR);
+    }
+    close(conn);
+    for (int fd = 0; fd < STDIO_FDS_COUNT; ++fd) {
+        dup2(stdio_fds[fd], fd);
+        close(stdio_fds[fd]);
+    }
+
+    try {
+        // proc and sys can be mounted in user ns only while a fully visible
+        // instance exists, so new ones are mounted aside first and then moved
+        // over zygote's binds of host /proc and /sys, which are detached
+        check_result(mount("tmp", "/tmp", "tmpfs", 0, nullptr), "Failed to mount tmp fs");
+        check_result(mkdir("/tmp/.proc", 0555), "Failed to make proc mount point");
+        check_result(mkdir("/tmp/.sys", 0555), "Failed to make sys mount point");
+        check_result(mount("proc", "/tmp/.proc", "proc", 0, nullptr), "Failed to mount proc fs");
+        check_result(mount("sys", "/tmp/.sys", "sysfs", 0, nullptr), "Failed to mount sys fs");
+        check_result(umount2("/proc", MNT_DETACH), "Failed to umount zygote proc");
+        check_result(umount2("/sys", MNT_DETACH), "Failed to umount zygote sys");
+        check_result(mount("/tmp/.proc", "/proc", nullptr, MS_MOVE, nullptr), "Failed to move proc fs");
+        check_result(mount("/tmp/.sys", "/sys", nullptr, MS_MOVE, nullptr), "Failed to move sys fs");
+        rmdir("/tmp/.proc");
+        rmdir("/tmp/.sys");
+
+        static std::string const HOSTNAME("container");
+        check_result(sethostname(HOSTNAME.c_str(), HOSTNAME.length()), "sethostname failed");
+        umask(0);
+        if (daemonize) {
+            check_result(setsid(), "Failed to create new session and precess group");
+        }
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        _exit(EXCEPTION_OCCURED_ERROR);
+    }
+
+    std::vector<char*> exec_argv;
+    for (size_t arg_idx = 1; arg_idx < argv.size(); ++arg_idx) {
+        exec_argv.push_back(const_cast<char*>(argv[arg_idx].c_str()));
+    }
+    exec_argv.push_back(nullptr);
+    if (entry) {
+        int const result = entry(exec_argv.size() - 1, exec_argv.data());
+        std::cout.flush();
+        fflush(nullptr);
+        _exit(result); // zygote's atexit handlers and destructors mustn't run
+    }
+    execv(argv[0].c_str(), exec_argv.data());
+    _exit(EXECUTE_COMMAND_ERROR);
+}
+
+// Runs in process forked by zygote for each request. Unshares new namespace
+// set, forks container (pid 1 of new pid ns), reports its pid and exit status.
+static void handle_request(int conn, entry_function entry) {
+    std::vector<char> buffer(MAX_REQUEST_SIZE);
+    char control[CMSG_SPACE(sizeof(int) * STDIO_FDS_COUNT)] = {0};
+    iovec iov = {buffer.data(), buffer.size()};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t const size = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (size < static_cast<ssize_t>(sizeof(request_header)) || cmsg == nullptr ||
+            cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * STDIO_FDS_COUNT)) {
+        _exit(INVALID_ARGS_ERROR);
+    }
+    int stdio_fds[STDIO_FDS_COUNT];
+    std::copy(reinterpret_cast<int*>(CMSG_DATA(cmsg)), reinterpret_cast<int*>(CMSG_DATA(cmsg)) + STDIO_FDS_COUNT,
+              stdio_fds);
+    request_header header;
+    std::copy(buffer.data(), buffer.data() + sizeof(header), reinterpret_cast<char*>(&header));
+    std::vector<std::string> argv;
+    for (char const *arg = buffer.data() + sizeof(header); arg < buffer.data() + size; arg += argv.back().size() + 1) {
+        argv.push_back(std::string(arg, strnlen(arg, buffer.data() + size - arg)));
+    }
+    if (argv.size() != header.args_count + 1 || argv.size() < 2) {
+        _exit(INVALID_ARGS_ERROR);
+    }
+
+    int pid = -1;
+    if (unshare(CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWNET | CLONE_NEWPID | CLONE_NEWNS) == 0) {
+        pid = fork();
+        if (pid == 0) {
+            container_from_template(conn, argv, stdio_fds, header.daemonize, entry);
+        }
+    }
+    for (int fd: stdio_fds) {
+        close(fd);
+    }
+    send(conn, &pid, sizeof(pid), 0);
+    if (pid == -1) {
+        _exit(EXCEPTION_OCCURED_ERROR);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    send(conn, &status, sizeof(status), 0);
+    _exit(0);
+}
+
+// Kernel reports invalid map on write, so stream is flushed before check
+static void write_proc_file(std::string const &path, std::string const &value) {
+    std::ofstream file(path);
+    if (!(file << value << std::flush)) {
+        throw aucont_exception("Failed to write " + path);
+    }
+}
+
+// Enters image in own user and mount ns, preloads libraries and serves
+// container fork requests. Writes 'r' to ready_fd when it is ready.
+static void zygote_main(template_arguments const &args, int listen_fd, int ready_fd) {
+    std::string const uid_str = std::to_string(getuid());
+    std::string const gid_str = std::to_string(getgid());
+    check_result(unshare(CLONE_NEWUSER), "Failed to create user ns");
+    write_proc_file("/proc/self/setgroups", "deny");
+    write_proc_file("/proc/self/uid_map", "0 " + uid_str + " 1");
+    write_proc_file("/proc/self/gid_map", "0 " + gid_str + " 1");
+    check_result(unshare(CLONE_NEWNS), "Failed to create mount ns");
+    check_result(mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr), "Failed to make mounts private");
+
+    std::string const &image = args.image_path;
+    check_result(mount(image.c_str(), image.c_str(), "bind", MS_BIND | MS_REC, nullptr), "Mount image_path");
+    check_result(mount("/proc", (image + "/proc").c_str(), nullptr, MS_BIND | MS_REC, nullptr), "Bind proc");
+    check_result(mount("/sys", (image + "/sys").c_str(), nullptr, MS_BIND | MS_REC, nullptr), "Bind sys");
+    std::string const tmp_old_root = "/old_root";
+    check_result(mkdir((image + tmp_old_root).c_str(), 0777), "Make tmp_old_root_dir", [](int code) {
+        return code != -1 || errno == EEXIST;
+    });
+    check_result(syscall(SYS_pivot_root, image.c_str(), (image + tmp_old_root).c_str()), "Change root dir");
+    check_result(chdir("/"), "Failed to chdir to new root");
+    check_result(umount2(tmp_old_root.c_str(), MNT_DETACH), "Umount old root");
+
+    // Preloaded libraries stay mapped in zygote, so their pages are hot in
+    // page cache and shared with every container started from template
+    for (std::string const &library: args.preload) {
+        if (dlopen(library.c_str(), RTLD_NOW | RTLD_GLOBAL) == nullptr) {
+            throw aucont_exception("Failed to preload " + library + ": " + dlerror());
+        }
+    }
+    entry_function entry = nullptr;
+    if (!args.entry.empty()) {
+        entry = reinterpret_cast<entry_function>(dlsym(RTLD_DEFAULT, args.entry.c_str()));
+        if (entry == nullptr) {
+            throw aucont_exception("Entry " + args.entry + " isn't found in preloaded libraries");
+        }
+    }
+
+    signal(SIGCHLD, SIG_IGN); // request handlers are reaped automatically
+    check_result(write(ready_fd, "r", 1), "Failed to report zygote readiness");
+    close(ready_fd);
+    freopen("/dev/null", "r", stdin);
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+
+    while (true) {
+        int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn == -1) {
+            continue;
+        }
+        if (fork() == 0) {
+            close(listen_fd);
+            signal(SIGCHLD, SIG_DFL);
+            handle_request(conn, entry);
+        }
+        close(conn);
+    }
+}
+
+static int stop_template(template_arguments const &args) {
+    int zygote_pid = 0;
+    std::ifstream(pid_file_path(args.name)) >> zygote_pid;
+    if (zygote_pid <= 0) {
+        std::cout << "Template " << args.name << " is not running" << std::endl;
+        return 0;
+    }
+    if (kill(zygote_pid, SIGTERM) == 0 && args.debug_enabled) {
+        printDebug() << "Zygote " << zygote_pid << " stopped" << std::endl;
+    }
+    unlink(socket_path(args.name).c_str());
+    unlink(pid_file_path(args.name).c_str());
+    return 0;
+}
+
+int aucont_template(template_arguments const &args) {
+    try {
+        if (args.stop) {
+            return stop_template(args);
+        }
+        if (args.debug_enabled) {
+            printDebug() << "Template " << args.name << " from image '" << args.image_path << '\'' << std::endl;
+            for (std::string const &library: args.preload) {
+                printDebug() << "\tpreload '" << library << '\'' << std::endl;
+            }
+            if (!args.entry.empty()) {
+                printDebug() << "\tentry '" << args.entry << '\'' << std::endl;
+            }
+        }
+
+        exec_check_result("mkdir -p " + TEMPLATES_DIR);
+        std::string const path = socket_path(args.name);
+        unlink(path.c_str());
+        int const listen_fd = check_result(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0),
+                                           "Failed to create template socket");
+        sockaddr_un addr = make_addr(path);
+        check_result(bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)),
+                     "Failed to bind template socket " + path);
+        check_result(listen(listen_fd, SOMAXCONN), "Failed to listen template socket");
+
+        int ready_pipe[2];
+        check_result(pipe2(ready_pipe, O_CLOEXEC), "Failed to create pipe");
+        int const zygote_pid = check_result(fork(), "Failed to fork zygote");
+        if (zygote_pid == 0) {
+            close(ready_pipe[0]);
+            setsid();
+            int return_code = 0;
+            try {
+                zygote_main(args, listen_fd, ready_pipe[1]);
+            } catch(std::exception &e) {
+                std::cerr << "Zygote exception: " << e.what() << std::endl;
+                return_code = EXCEPTION_OCCURED_ERROR;
+            }
+            _exit(return_code);
+        }
+        close(ready_pipe[1]);
+        close(listen_fd);
+        char ready = 0;
+        bool const started = read(ready_pipe[0], &ready, 1) == 1 && ready == 'r';
+        close(ready_pipe[0]);
+        if (!started) {
+            waitpid(zygote_pid, nullptr, 0);
+            unlink(path.c_str());
+            throw aucont_exception("Zygote failed to start");
+        }
+        std::ofstream(pid_file_path(args.name)) << zygote_pid;
+        std::cout << zygote_pid << std::endl;
+        return 0;
+    } catch(std::exception &e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXCEPTION_OCCURED_ERROR;
+    }
+}
+
+/*Client side**********************************/
+
+int zygote_fork_container(std::string const &name, std::string const &cmd, char *const *cmd_args,
+                          bool daemonize, int log_fd, int &conn) {
+    std::vector<char> request(sizeof(request_header));
+    request_header header = {daemonize, 0};
+    request.insert(request.end(), cmd.c_str(), cmd.c_str() + cmd.size() + 1);
+    for (char *const *arg = cmd_args; *arg; ++arg) {
+        request.insert(request.end(), *arg, *arg + strlen(*arg) + 1);
+        header.args_count += 1;
+    }
+    std::copy(reinterpret_cast<char*>(&header), reinterpret_cast<char*>(&header) + sizeof(header), request.begin());
+    check_result(request.size() <= MAX_REQUEST_SIZE, "Too long command line", [](int ok) { return ok != 0; });
+
+    conn = check_result(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0), "Failed to create socket");
+    sockaddr_un addr = make_addr(socket_path(name));
+    check_result(connect(conn, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)),
+                 "Template " + name + " is not running");
+
+    int stdio_fds[STDIO_FDS_COUNT] = {0, 1, 2};
+    int null_fd = -1;
+    if (daemonize) {
+        null_fd = check_result(open("/dev/null", O_RDWR | O_CLOEXEC), "Failed to open /dev/null");
+        std::fill(stdio_fds, stdio_fds + STDIO_FDS_COUNT, null_fd);
+    }
+    if (log_fd != -1) {
+        stdio_fds[1] = stdio_fds[2] = log_fd;
+    }
+    char control[CMSG_SPACE(sizeof(stdio_fds))] = {0};
+    iovec iov = {request.data(), request.size()};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(stdio_fds));
+    std::copy(stdio_fds, stdio_fds + STDIO_FDS_COUNT, reinterpret_cast<int*>(CMSG_DATA(cmsg)));
+    ssize_t const sent = sendmsg(conn, &msg, 0);
+    if (null_fd != -1) {
+        close(null_fd);
+    }
+    check_result(sent, "Failed to send request to template " + name);
+
+    int pid = -1;
+    check_result(recv(conn, &pid, sizeof(pid), 0) == sizeof(pid) && pid > 0,
+                 "Template " + name + " failed to fork container", [](int ok) { return ok != 0; });
+    return pid;
+}
+
+void zygote_release_container(int conn) {
+    check_result(send(conn, "g", 1, 0), "Failed to release container");
+}
+
+int zygote_wait_container(int conn) {
+    int status = 0;
+    check_result(recv(conn, &status, sizeof(status), 0) == sizeof(status), "Lost connection to template",
+                 [](int ok) { return ok != 0; });
+    return status;
+}
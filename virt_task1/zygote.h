@@ -0,0 +1,23 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+#include <string>
+
+// Client side of template zygote protocol. Zygote forks container process
+// which waits for zygote_release_container before exec of its command or
+// call of template entry function.
+
+// Asks zygote of template 'name' to fork container running cmd with cmd_args
+// (execv style, cmd_args[0] is program name). Container gets our stdio fds or
+// /dev/null if daemonize, stdout and stderr go to log_fd unless it is -1.
+// Returns container pid (in our pid ns), conn gets connection to zygote which
+// must be used for release and wait.
+int zygote_fork_container(std::string const &name, std::string const &cmd, char *const *cmd_args,
+                          bool daemonize, int log_fd, int &conn);
+
+// Lets forked container execute its command
+void zygote_release_container(int conn);
+
+// Waits for container exit, returns waitpid status
+int zygote_wait_container(int conn);
+
+#endif // ZYGOTE_H